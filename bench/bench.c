@@ -0,0 +1,477 @@
+/**
+ * @file bench.c
+ * @brief throughput benchmarks for the codecs, the actions and whole jobs
+ *
+ * every measurement is one row: group, name, variant (simd level and
+ * thread count), input size, iterations, time, GB/s and cycles per byte.
+ * rows are written as csv or json so runs can be compared between releases.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/isenchef.h"
+#include "../include/encoders.h"
+#include "../include/pipeline.h"
+#include "../include/processor.h"
+#include "../include/workers.h"
+#include "../include/cpu.h"
+
+#ifdef ISENCHEF_X86
+#include <x86intrin.h>
+#endif
+
+typedef enum {
+    OUTPUT_CSV,
+    OUTPUT_JSON
+} output_t;
+
+/* command line settings */
+static output_t output = OUTPUT_CSV;
+static size_t max_size = 64 * 1024 * 1024;
+static size_t e2e_size = 64 * 1024 * 1024;
+static double min_time = 0.1;
+static int parallel_threads = 0;
+static const char *filter = NULL;
+static int rows = 0;
+
+/* what one timed call works on */
+typedef struct {
+    const uint8_t *input;
+    size_t size;
+    uint8_t *data;
+    char *text;
+    size_t text_size;
+    pipeline_t *pipeline;
+    const config_t *config;
+    io_scratch_t *scratch;
+} bench_case_t;
+
+typedef void (*bench_fn)(bench_case_t *c);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* time stamp counter cycles, 0 where there is none */
+static uint64_t cycles(void) {
+#ifdef ISENCHEF_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int selected(const char *group, const char *name) {
+    return !filter || strstr(group, filter) || strstr(name, filter);
+}
+
+static void emit(const char *group, const char *name, const char *variant, size_t size,
+                 size_t iterations, double seconds, uint64_t cycle_count) {
+    double bytes = (double)size * (double)iterations;
+    double gbps = (seconds > 0.0) ? bytes / seconds / 1e9 : 0.0;
+    double cpb = (bytes > 0.0) ? (double)cycle_count / bytes : 0.0;
+
+    if (output == OUTPUT_CSV) {
+        printf("%s,%s,%s,%zu,%zu,%.6f,%.3f,%.3f\n", group, name, variant, size, iterations,
+               seconds, gbps, cpb);
+    } else {
+        printf("%s\n    {\"group\": \"%s\", \"name\": \"%s\", \"variant\": \"%s\", "
+               "\"size\": %zu, \"iterations\": %zu, \"seconds\": %.6f, "
+               "\"gb_per_s\": %.3f, \"cycles_per_byte\": %.3f}",
+               rows ? "," : "", group, name, variant, size, iterations, seconds, gbps, cpb);
+    }
+    fflush(stdout);
+    rows++;
+}
+
+/* run fn until min_time has passed (at least once after a warm-up call) */
+static void measure(const char *group, const char *name, const char *variant, size_t size,
+                    bench_fn fn, bench_case_t *c) {
+    size_t iterations = 0;
+    double elapsed;
+
+    fn(c);
+    double start = now();
+    uint64_t start_cycles = cycles();
+    do {
+        fn(c);
+        iterations++;
+        elapsed = now() - start;
+    } while (elapsed < min_time);
+    emit(group, name, variant, size, iterations, elapsed, cycles() - start_cycles);
+}
+
+static void run_encode_hex(bench_case_t *c) {
+    encode_hex(c->input, c->size, c->text);
+}
+
+static void run_decode_hex(bench_case_t *c) {
+    decode_hex(c->text, c->data, c->size + 1);
+}
+
+static void run_encode_base64(bench_case_t *c) {
+    size_t len;
+    encode_base64(c->input, c->size, c->text, c->text_size, &len);
+}
+
+static void run_decode_base64(bench_case_t *c) {
+    decode_base64(c->text, c->data, c->size + 3);
+}
+
+static void run_pipeline(bench_case_t *c) {
+    pipeline_run(c->pipeline, c->data, c->size);
+}
+
+static void run_job(bench_case_t *c) {
+    execute_job(c->config, c->scratch);
+}
+
+static void fill_random(uint8_t *data, size_t size) {
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (uint8_t)state;
+    }
+}
+
+/* insert a line break every 76 characters like mime base64 */
+static size_t wrap_lines(const char *text, size_t len, char *wrapped) {
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        wrapped[out++] = text[i];
+        if (i % 76 == 75) {
+            wrapped[out++] = '\n';
+        }
+    }
+    wrapped[out] = '\0';
+    return out;
+}
+
+static int start_threads(int threads) {
+    workers_stop();
+    return (threads == 1) ? 0 : workers_start(threads);
+}
+
+static void bench_codecs(const uint8_t *input, size_t size) {
+    static const struct {
+        const char *name;
+        bench_fn fn;
+    } codecs[] = {
+        {"encode_hex", run_encode_hex},
+        {"decode_hex", run_decode_hex},
+        {"encode_base64", run_encode_base64},
+        {"decode_base64", run_decode_base64},
+        {"decode_base64_mime", run_decode_base64},
+    };
+    size_t text_size = size * 2 + size / 38 + 8;
+    char *text = (char *)malloc(text_size);
+    char *lines = (char *)malloc(text_size);
+    uint8_t *data = (uint8_t *)malloc(size + 3);
+    char variant[32];
+
+    if (!text || !lines || !data) {
+        fprintf(stderr, "bench: not enough memory for %zu byte codecs, skipped\n", size);
+        goto cleanup;
+    }
+    for (size_t k = 0; k < sizeof(codecs) / sizeof(codecs[0]); k++) {
+        bench_case_t c = {input, size, data, text, text_size, NULL, NULL, NULL};
+
+        if (!selected("codec", codecs[k].name)) {
+            continue;
+        }
+        /* decoders get valid input made by the encoders */
+        if (codecs[k].fn == run_decode_hex) {
+            encode_hex(input, size, text);
+        } else if (codecs[k].fn == run_decode_base64) {
+            size_t len = 0;
+            encode_base64(input, size, text, text_size, &len);
+            if (strcmp(codecs[k].name, "decode_base64_mime") == 0) {
+                wrap_lines(text, len, lines);
+                c.text = lines;
+            }
+        }
+
+        for (int level = CPU_SCALAR; level <= (int)cpu_supported_level(); level++) {
+            cpu_set_level((cpu_level_t)level);
+            snprintf(variant, sizeof(variant), "%s", cpu_level_name((cpu_level_t)level));
+            measure("codec", codecs[k].name, variant, size, codecs[k].fn, &c);
+        }
+        /* the encoders split large inputs across the pool */
+        if (codecs[k].fn == run_encode_hex || codecs[k].fn == run_encode_base64) {
+            if (size >= WORKERS_MIN_PARALLEL && start_threads(parallel_threads) == 0 &&
+                workers_count() > 1) {
+                snprintf(variant, sizeof(variant), "%s/t%d",
+                         cpu_level_name(cpu_supported_level()), workers_count());
+                measure("codec", codecs[k].name, variant, size, codecs[k].fn, &c);
+            }
+            start_threads(1);
+        }
+    }
+
+cleanup:
+    free(data);
+    free(lines);
+    free(text);
+}
+
+static void bench_actions(const uint8_t *input, size_t size) {
+    static char key3[] = "k3y";
+    static char key32[] = "0123456789abcdef0123456789abcdef";
+    static char shift[] = "13";
+    static char secret[] = "secret";
+    static const struct {
+        const char *name;
+        recipe_step_t step;
+        int parallel;
+    } actions[] = {
+        {"caesar", {ACTION_CAESAR, shift, 0, 0}, 1},
+        {"uppercase", {ACTION_UPPERCASE, NULL, 0, 0}, 1},
+        {"lowercase", {ACTION_LOWERCASE, NULL, 0, 0}, 1},
+        {"xor_key3", {ACTION_XOR, key3, 0, 0}, 1},
+        {"xor_key32", {ACTION_XOR, key32, 0, 0}, 1},
+        {"rc4", {ACTION_RC4, secret, 0, 0}, 1},
+    };
+    uint8_t *data = (uint8_t *)malloc(size);
+    char variant[32];
+
+    if (!data) {
+        fprintf(stderr, "bench: not enough memory for %zu byte actions, skipped\n", size);
+        return;
+    }
+    memcpy(data, input, size);
+    for (size_t k = 0; k < sizeof(actions) / sizeof(actions[0]); k++) {
+        pipeline_t pipeline;
+        bench_case_t c = {input, size, data, NULL, 0, &pipeline, NULL, NULL};
+
+        if (!selected("action", actions[k].name)) {
+            continue;
+        }
+        for (int level = CPU_SCALAR; level <= (int)cpu_supported_level(); level++) {
+            cpu_set_level((cpu_level_t)level);
+            if (pipeline_init(&pipeline, &actions[k].step, 1) < 0) {
+                continue;
+            }
+            measure("action", actions[k].name, cpu_level_name((cpu_level_t)level), size,
+                    run_pipeline, &c);
+            pipeline_free(&pipeline);
+        }
+        /* slices across the pool, or the keystream thread for rc4 */
+        if (actions[k].parallel && size >= WORKERS_MIN_PARALLEL &&
+            start_threads(parallel_threads) == 0 && workers_count() > 1 &&
+            pipeline_init(&pipeline, &actions[k].step, 1) == 0) {
+            snprintf(variant, sizeof(variant), "%s/t%d", cpu_level_name(cpu_supported_level()),
+                     workers_count());
+            measure("action", actions[k].name, variant, size, run_pipeline, &c);
+            pipeline_free(&pipeline);
+        }
+        start_threads(1);
+    }
+    free(data);
+}
+
+static int write_file_raw(const char *path, const void *data, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    int result = (fwrite(data, 1, size, file) == size) ? 0 : -1;
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+static void bench_jobs(const uint8_t *input, size_t size) {
+    static char key[] = "k3y";
+    static char secret[] = "secret";
+    char dir[] = "/tmp/isenchef_bench.XXXXXX";
+    char bin[64];
+    char hex[64];
+    char b64[64];
+    char out[64];
+    char variant[32];
+    char *text = (char *)malloc(size * 2 + 8);
+    recipe_step_t xor_step = {ACTION_XOR, key, 0, 0};
+    recipe_step_t rc4_step = {ACTION_RC4, secret, 0, 0};
+    io_scratch_t scratch = {0};
+
+    if (!text || !mkdtemp(dir)) {
+        fprintf(stderr, "bench: cannot prepare job files, skipped\n");
+        free(text);
+        return;
+    }
+    snprintf(bin, sizeof(bin), "%s/in.bin", dir);
+    snprintf(hex, sizeof(hex), "%s/in.hex", dir);
+    snprintf(b64, sizeof(b64), "%s/in.b64", dir);
+    snprintf(out, sizeof(out), "%s/out", dir);
+    encode_hex(input, size, text);
+    int hex_ok = write_file_raw(hex, text, size * 2);
+    size_t len;
+    int b64_ok = encode_base64(input, size, text, size * 2 + 8, &len);
+    if (write_file_raw(bin, input, size) < 0 || hex_ok < 0 || b64_ok < 0 ||
+        write_file_raw(b64, text, len) < 0) {
+        goto cleanup;
+    }
+
+    const struct {
+        const char *name;
+        char *input;
+        format_t input_format;
+        format_t output_format;
+        recipe_step_t *step;
+        int streaming;
+        int mapped;
+    } jobs[] = {
+        {"bytes_to_hex", bin, FORMAT_BYTES, FORMAT_HEX, NULL, 0, 0},
+        {"hex_to_bytes", hex, FORMAT_HEX, FORMAT_BYTES, NULL, 0, 0},
+        {"base64_xor_to_bytes", b64, FORMAT_BASE64, FORMAT_BYTES, &xor_step, 0, 0},
+        {"bytes_rc4_to_bytes", bin, FORMAT_BYTES, FORMAT_BYTES, &rc4_step, 0, 0},
+        {"bytes_xor_to_base64_stream", bin, FORMAT_BYTES, FORMAT_BASE64, &xor_step, 1, 0},
+        {"bytes_xor_to_bytes_mmap", bin, FORMAT_BYTES, FORMAT_BYTES, &xor_step, 0, 1},
+    };
+    for (size_t k = 0; k < sizeof(jobs) / sizeof(jobs[0]); k++) {
+        config_t config;
+        bench_case_t c = {input, size, NULL, NULL, 0, NULL, &config, &scratch};
+
+        if (!selected("job", jobs[k].name)) {
+            continue;
+        }
+        memset(&config, 0, sizeof(config));
+        config.input_file = jobs[k].input;
+        config.output_file = out;
+        config.input_format = jobs[k].input_format;
+        config.output_format = jobs[k].output_format;
+        config.steps = jobs[k].step;
+        config.step_count = jobs[k].step ? 1 : 0;
+        config.streaming = jobs[k].streaming;
+        config.chunk_size = MAX_BUFFER_SIZE;
+        config.mapped = jobs[k].mapped;
+
+        int thread_counts[2] = {1, parallel_threads};
+        for (int t = 0; t < 2; t++) {
+            if (start_threads(thread_counts[t]) < 0 || (t == 1 && workers_count() == 1)) {
+                continue;
+            }
+            snprintf(variant, sizeof(variant), "%s/t%d", cpu_level_name(cpu_supported_level()),
+                     workers_count());
+            measure("job", jobs[k].name, variant, size, run_job, &c);
+        }
+        start_threads(1);
+    }
+
+cleanup:
+    free_scratch(&scratch);
+    remove(bin);
+    remove(hex);
+    remove(b64);
+    remove(out);
+    rmdir(dir);
+    free(text);
+}
+
+/* parse a byte count with optional k/m/g suffix, 0 on error */
+static size_t parse_bytes(const char *str) {
+    char *end;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (end == str) {
+        return 0;
+    }
+    switch (*end) {
+        case 'g':
+        case 'G':
+            value *= 1024;
+            /* fallthrough */
+        case 'm':
+        case 'M':
+            value *= 1024;
+            /* fallthrough */
+        case 'k':
+        case 'K':
+            value *= 1024;
+            end++;
+            break;
+        default:
+            break;
+    }
+    return (*end == '\0') ? (size_t)value : 0;
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "usage: %s [options]\n", program_name);
+    fprintf(stderr, "  --format csv|json      output format (default csv)\n");
+    fprintf(stderr, "  --max-size <n>         largest codec/action input, k/m/g suffix "
+                    "(default 64m, 1g for the full sweep)\n");
+    fprintf(stderr, "  --job-size <n>         input size of the whole-job runs (default 64m)\n");
+    fprintf(stderr, "  --min-time <seconds>   minimum time per row (default 0.1)\n");
+    fprintf(stderr, "  --threads <n>          threads for the parallel rows (0 = one per cpu)\n");
+    fprintf(stderr, "  --filter <text>        only run groups or names containing text\n");
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--format") == 0 && value) {
+            output = (strcmp(value, "json") == 0) ? OUTPUT_JSON : OUTPUT_CSV;
+        } else if (strcmp(argv[i], "--max-size") == 0 && value) {
+            max_size = parse_bytes(value);
+        } else if (strcmp(argv[i], "--job-size") == 0 && value) {
+            e2e_size = parse_bytes(value);
+        } else if (strcmp(argv[i], "--min-time") == 0 && value) {
+            min_time = atof(value);
+        } else if (strcmp(argv[i], "--threads") == 0 && value) {
+            parallel_threads = atoi(value);
+        } else if (strcmp(argv[i], "--filter") == 0 && value) {
+            filter = value;
+        } else {
+            print_usage(argv[0]);
+            return (strcmp(argv[i], "--help") == 0) ? 0 : 1;
+        }
+        i++;
+    }
+    if (max_size < 64 || e2e_size == 0) {
+        fprintf(stderr, "invalid size\n");
+        return 1;
+    }
+
+    size_t largest = (max_size > e2e_size) ? max_size : e2e_size;
+    uint8_t *input = (uint8_t *)malloc(largest);
+    if (!input) {
+        fprintf(stderr, "memory allocation failed\n");
+        return 1;
+    }
+    fill_random(input, largest);
+
+    if (output == OUTPUT_CSV) {
+        printf("group,name,variant,size,iterations,seconds,gb_per_s,cycles_per_byte\n");
+    } else {
+        printf("{\"cpu\": \"%s\", \"results\": [", cpu_level_name(cpu_supported_level()));
+    }
+
+    /* 64 B to max_size, x16 per step */
+    for (size_t size = 64; size <= max_size; size *= 16) {
+        bench_codecs(input, size);
+        bench_actions(input, size);
+        if (size > max_size / 16 && size != max_size) {
+            bench_codecs(input, max_size);
+            bench_actions(input, max_size);
+        }
+    }
+    cpu_set_level(cpu_supported_level());
+    bench_jobs(input, e2e_size);
+
+    if (output == OUTPUT_JSON) {
+        printf("\n]}\n");
+    }
+    workers_stop();
+    free(input);
+    return 0;
+}
@@ -8,6 +8,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "rc4.h"
 
 /**
  * @brief apply caesar cipher
@@ -18,6 +19,16 @@
  */
 int action_caesar(uint8_t *data, size_t size, int shift);
 
+/**
+ * @brief apply caesar cipher while copying src to dst
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @param shift shift value (positive or negative)
+ * @return 0 on success, -1 on error
+ */
+int action_caesar_copy(const uint8_t *src, uint8_t *dst, size_t size, int shift);
+
 /**
  * @brief apply rc4 cipher
  * @param data data buffer
@@ -35,6 +46,15 @@ int action_rc4(uint8_t *data, size_t size, const char *key);
  */
 int action_uppercase(uint8_t *data, size_t size);
 
+/**
+ * @brief convert text to uppercase while copying src to dst
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @return 0 on success, -1 on error
+ */
+int action_uppercase_copy(const uint8_t *src, uint8_t *dst, size_t size);
+
 /**
  * @brief convert text to lowercase
  * @param data data buffer
@@ -43,6 +63,15 @@ int action_uppercase(uint8_t *data, size_t size);
  */
 int action_lowercase(uint8_t *data, size_t size);
 
+/**
+ * @brief convert text to lowercase while copying src to dst
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @return 0 on success, -1 on error
+ */
+int action_lowercase_copy(const uint8_t *src, uint8_t *dst, size_t size);
+
 /**
  * @brief apply xor operation
  * @param data data buffer
@@ -52,5 +81,27 @@ int action_lowercase(uint8_t *data, size_t size);
  */
 int action_xor(uint8_t *data, size_t size, const char *key);
 
+/**
+ * @brief apply xor operation to a slice that starts at a given stream offset
+ * @param data data buffer
+ * @param size buffer size
+ * @param key xor key (null-terminated string)
+ * @param offset position of data[0] in the whole stream, selects the key byte
+ * @return 0 on success, -1 on error
+ */
+int action_xor_offset(uint8_t *data, size_t size, const char *key, size_t offset);
+
+/**
+ * @brief apply xor operation while copying src to dst
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @param key xor key (null-terminated string)
+ * @param offset position of src[0] in the whole stream, selects the key byte
+ * @return 0 on success, -1 on error
+ */
+int action_xor_copy(const uint8_t *src, uint8_t *dst, size_t size, const char *key,
+                    size_t offset);
+
 #endif /* ACTIONS_H */
 
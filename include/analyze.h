@@ -0,0 +1,43 @@
+/**
+ * @file analyze.h
+ * @brief key recovery for caesar and xor ciphertexts (--analyze)
+ */
+
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include "isenchef.h"
+
+/* --analyze modes, stored in config_t.analyze */
+#define ANALYZE_NONE 0
+#define ANALYZE_CAESAR 1
+#define ANALYZE_XOR 2
+#define ANALYZE_ALL 3  /* ANALYZE_CAESAR | ANALYZE_XOR */
+
+/* longest repeating xor key tried, --max-key-length */
+#define ANALYZE_MAX_KEY 64
+#define ANALYZE_DEFAULT_KEY 32
+
+/* bytes at the front of the input the key length is estimated on */
+#define ANALYZE_SAMPLE (8 * 1024 * 1024)
+
+/* candidates printed per ranking */
+#define ANALYZE_TOP 5
+
+/**
+ * @brief rank the likely caesar shifts and xor keys of the decoded input
+ *
+ * the input is assumed to be english text once deciphered. byte
+ * histograms are built over the whole input on the worker pool, then
+ * every caesar shift and single-byte xor key is scored from them. the
+ * repeating xor key length is estimated by the hamming distance between
+ * bytes length apart, and each likely length gets one histogram per key
+ * position to pick its key bytes. the rankings go to config->output_file.
+ *
+ * @param config configuration, analyze is not ANALYZE_NONE
+ * @param scratch buffers the input is read into
+ * @return 0 on success, -1 on error
+ */
+int analyze_execute(const config_t *config, io_scratch_t *scratch);
+
+#endif /* ANALYZE_H */
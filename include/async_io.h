@@ -0,0 +1,90 @@
+/**
+ * @file async_io.h
+ * @brief read-ahead and write-behind rings of buffers for the streaming path
+ *
+ * a reader keeps the next chunks of a file in flight while the caller works
+ * on the current one, a writer keeps the previous chunks in flight while
+ * the caller fills the next buffer. io_uring is used on regular files when
+ * the kernel has it, a helper thread doing blocking reads or writes
+ * everywhere else.
+ */
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* --io backends, stored in config_t.io_backend */
+#define IO_AUTO 0     /* io_uring where possible, else threads */
+#define IO_URING 1    /* same as auto, io_uring is never forced on a pipe */
+#define IO_THREADS 2  /* one helper thread per direction */
+#define IO_SYNC 3     /* blocking stdio, no overlap */
+
+/* buffers of one reader or writer, all but one of them in flight */
+#define ASYNC_IO_DEPTH 4
+
+typedef struct async_reader async_reader_t;
+typedef struct async_writer async_writer_t;
+
+/**
+ * @brief start reading a file ahead in chunks
+ * @param fd file to read from its current position, left open
+ * @param chunk bytes per chunk
+ * @param backend IO_AUTO, IO_URING or IO_THREADS
+ * @return reader, NULL on error or when backend is IO_SYNC
+ */
+async_reader_t *async_reader_open(int fd, size_t chunk, int backend);
+
+/**
+ * @brief take the next chunk, giving the previous one back to the ring
+ *
+ * every chunk is full except the last one, which is shorter (possibly
+ * empty). next must not be called again after it. the chunk may be
+ * modified and stays valid until the next call or until close.
+ *
+ * @param reader reader
+ * @param data set to the chunk
+ * @param size set to its size
+ * @return 0 on success, -1 on error
+ */
+int async_reader_next(async_reader_t *reader, uint8_t **data, size_t *size);
+
+/**
+ * @brief wait for reads still in flight and free the reader
+ * @param reader reader, may be NULL
+ */
+void async_reader_close(async_reader_t *reader);
+
+/**
+ * @brief start writing a file behind the caller
+ * @param fd file to write from its current position, left open
+ * @param buffer_size size of each buffer
+ * @param backend IO_AUTO, IO_URING or IO_THREADS
+ * @return writer, NULL on error or when backend is IO_SYNC
+ */
+async_writer_t *async_writer_open(int fd, size_t buffer_size, int backend);
+
+/**
+ * @brief get the buffer to fill next, waiting for a write to finish if all are in flight
+ * @param writer writer
+ * @return buffer of buffer_size bytes, NULL when an earlier write failed
+ */
+uint8_t *async_writer_buffer(async_writer_t *writer);
+
+/**
+ * @brief queue the first size bytes of the buffer from async_writer_buffer
+ * @param writer writer
+ * @param size bytes to write
+ * @return 0 on success, -1 when an earlier write failed
+ */
+int async_writer_submit(async_writer_t *writer, size_t size);
+
+/**
+ * @brief wait for every queued write and free the writer
+ * @param writer writer, may be NULL
+ * @return 0 when everything was written, -1 otherwise
+ */
+int async_writer_close(async_writer_t *writer);
+
+#endif /* ASYNC_IO_H */
@@ -0,0 +1,29 @@
+/**
+ * @file batch.h
+ * @brief many jobs in one process, spread over the worker pool
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "isenchef.h"
+
+/**
+ * @brief run every job of a manifest or a directory tree
+ *
+ * with config->batch_file each non-empty line of the manifest is a job
+ * written with the usual options (--in, --out, --action, ...), '#' starts
+ * a comment line. with config->batch_dir every regular file below the
+ * directory is a job using the options of config, the output goes to the
+ * same relative path below config->output_file.
+ *
+ * jobs run concurrently on the worker pool and each thread keeps its
+ * buffers from one job to the next. a status line is printed per job
+ * and a throughput summary at the end.
+ *
+ * @param config batch configuration
+ * @return 0 if every job succeeded, -1 otherwise
+ */
+int batch_execute(const config_t *config);
+
+#endif /* BATCH_H */
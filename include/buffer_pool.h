@@ -0,0 +1,62 @@
+/**
+ * @file buffer_pool.h
+ * @brief process-wide pool of data buffers, recycled from one stage or job to the next
+ *
+ * sizes are rounded up to power-of-two classes and released buffers wait
+ * on a free list of their class, already faulted in. buffers of
+ * POOL_HUGE_MIN and more are mapped on their own, aligned for transparent
+ * huge pages. every buffer starts on a page.
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+/* smallest class, 64 KiB */
+#define POOL_MIN_SHIFT 16
+/* classes from 64 KiB to 2 GiB, larger buffers are not kept */
+#define POOL_CLASSES 16
+/* buffers from this size on are mappings advised for huge pages */
+#define POOL_HUGE_MIN (2 * 1024 * 1024)
+/* bytes kept on the free lists at most, the rest goes back to the system */
+#define POOL_CACHE_MAX ((size_t)512 * 1024 * 1024)
+
+/**
+ * @brief take a buffer of at least size bytes
+ * @param size bytes needed
+ * @param capacity set to the usable size of the buffer
+ * @return page-aligned buffer, NULL on error
+ */
+void *pool_alloc(size_t size, size_t *capacity);
+
+/**
+ * @brief make a buffer hold at least size bytes, keeping its first used bytes
+ * @param buffer buffer from the pool, may be NULL
+ * @param capacity its capacity, updated
+ * @param used bytes to keep
+ * @param size bytes needed
+ * @return the buffer or its replacement, NULL on error (buffer left as it was)
+ */
+void *pool_grow(void *buffer, size_t *capacity, size_t used, size_t size);
+
+/**
+ * @brief give the memory past the first used bytes back to the system
+ *
+ * the buffer keeps its capacity, the released pages come back zeroed when
+ * they are touched again.
+ *
+ * @param buffer buffer from the pool
+ * @param capacity its capacity
+ * @param used bytes still in use
+ */
+void pool_shrink(void *buffer, size_t capacity, size_t used);
+
+/**
+ * @brief hand a buffer back to the pool
+ * @param buffer buffer from the pool, may be NULL
+ * @param capacity capacity returned with it
+ */
+void pool_free(void *buffer, size_t capacity);
+
+#endif /* BUFFER_POOL_H */
@@ -0,0 +1,50 @@
+/**
+ * @file bytemap.h
+ * @brief stateless per-byte substitutions compiled into one lookup table
+ */
+
+#ifndef BYTEMAP_H
+#define BYTEMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "isenchef.h"
+
+/* composed substitution, table[b] is the output for input byte b */
+typedef struct {
+    uint8_t table[256];
+    uint16_t rows;  /* bit n set when table[n*16 .. n*16+15] is not the identity */
+} bytemap_t;
+
+/**
+ * @brief tell whether an action is a pure per-byte substitution
+ * @param action action type
+ * @return 1 for caesar, uppercase and lowercase, 0 otherwise
+ */
+int bytemap_accepts(action_t action);
+
+/**
+ * @brief reset a map to the identity
+ * @param map map to reset
+ */
+void bytemap_init(bytemap_t *map);
+
+/**
+ * @brief compose an action after the substitutions already in the map
+ * @param map map to extend
+ * @param action substitution action (see bytemap_accepts)
+ * @param shift caesar shift, ignored by the other actions
+ * @return 0 on success, -1 if the action is not a substitution
+ */
+int bytemap_append(bytemap_t *map, action_t action, int shift);
+
+/**
+ * @brief apply the map while copying src to dst
+ * @param map compiled map
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ */
+void bytemap_apply(const bytemap_t *map, const uint8_t *src, uint8_t *dst, size_t size);
+
+#endif /* BYTEMAP_H */
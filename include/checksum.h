@@ -0,0 +1,140 @@
+/**
+ * @file checksum.h
+ * @brief checksums taken on the data as it goes through a job (--checksum)
+ *
+ * a sum reads the data at one point of the job: decoded input, data after
+ * the actions, or encoded output. the callers feed it the blocks they are
+ * working on, so the data is hashed while it is still in cache and the
+ * files never have to be read again.
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "isenchef.h"
+
+/* algorithms, stored in checksum_spec_t.algorithm */
+#define CHECKSUM_CRC32C 0  /* castagnoli crc, sse4.2 crc32 instruction when available */
+#define CHECKSUM_XXH64 1   /* xxhash64, seed 0 */
+#define CHECKSUM_SHA256 2
+
+/* points of the job, stored in checksum_spec_t.point */
+#define CHECKSUM_DECODED 0      /* input after decoding, before the actions */
+#define CHECKSUM_TRANSFORMED 1  /* after the actions, before encoding */
+#define CHECKSUM_OUTPUT 2       /* the bytes written to the output file */
+
+/* longest digest, sha-256 */
+#define CHECKSUM_DIGEST_MAX 32
+
+typedef struct {
+    uint64_t v[4];
+    uint64_t total;
+    uint8_t buffer[32];
+    size_t buffered;
+} xxh64_state_t;
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t total;
+    uint8_t buffer[64];
+    size_t buffered;
+} sha256_state_t;
+
+/* one running sum */
+typedef struct {
+    int algorithm;
+    int point;
+    union {
+        uint32_t crc;
+        xxh64_state_t xxh;
+        sha256_state_t sha;
+    } state;
+} checksum_t;
+
+/* the sums of one job */
+typedef struct {
+    checksum_t *sums;
+    size_t count;
+    int raw_output;  /* the output is the transformed data itself, its sums follow it */
+} checksum_set_t;
+
+/**
+ * @brief parse "<algorithm>[:<point>]", the point defaults to output
+ * @param text crc32c, xxh64 or sha256, then decoded, transformed or output
+ * @param spec filled on success
+ * @return 0 on success, -1 on error
+ */
+int checksum_parse(const char *text, checksum_spec_t *spec);
+
+/**
+ * @brief start a sum
+ * @param sum sum to initialize
+ * @param algorithm CHECKSUM_CRC32C, CHECKSUM_XXH64 or CHECKSUM_SHA256
+ * @param point point of the job it reads
+ */
+void checksum_init(checksum_t *sum, int algorithm, int point);
+
+/**
+ * @brief add the next bytes to a sum
+ * @param sum sum
+ * @param data bytes
+ * @param size number of bytes
+ */
+void checksum_update(checksum_t *sum, const void *data, size_t size);
+
+/**
+ * @brief finish a sum
+ * @param sum sum, left unchanged
+ * @param digest filled with the digest, big-endian
+ * @return digest length in bytes
+ */
+size_t checksum_final(const checksum_t *sum, uint8_t digest[CHECKSUM_DIGEST_MAX]);
+
+/**
+ * @brief start the sums a configuration asks for
+ * @param set set to initialize, empty when there are none
+ * @param config configuration
+ * @param raw_output non-zero when the job writes its transformed data as it is
+ * @return 0 on success, -1 on error
+ */
+int checksum_set_init(checksum_set_t *set, const config_t *config, int raw_output);
+
+/**
+ * @brief tell whether data at a point feeds any sum
+ * @param set set, may be NULL
+ * @param point CHECKSUM_DECODED, CHECKSUM_TRANSFORMED or CHECKSUM_OUTPUT
+ * @return non-zero when it does
+ */
+int checksum_set_wants(const checksum_set_t *set, int point);
+
+/**
+ * @brief feed the next bytes seen at a point to its sums
+ *
+ * with raw_output, the transformed data also feeds the output sums.
+ *
+ * @param set set, may be NULL
+ * @param point point the data was taken at
+ * @param data bytes
+ * @param size number of bytes
+ */
+void checksum_set_update(checksum_set_t *set, int point, const void *data, size_t size);
+
+/**
+ * @brief print the sums of one point, "<algorithm> <point> <digest> <file>" per line
+ * @param set set
+ * @param out report stream
+ * @param point point to print
+ * @param file file the data belongs to
+ */
+void checksum_set_print(const checksum_set_t *set, FILE *out, int point, const char *file);
+
+/**
+ * @brief free a set
+ * @param set set
+ */
+void checksum_set_free(checksum_set_t *set);
+
+#endif /* CHECKSUM_H */
@@ -0,0 +1,66 @@
+/**
+ * @file cpu.h
+ * @brief runtime cpu feature detection for the vectorized kernels
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ISENCHEF_X86 1
+#endif
+
+/* instruction set levels, each one implies the previous ones */
+typedef enum {
+    CPU_SCALAR,
+    CPU_SSE2,
+    CPU_SSSE3,
+    CPU_AVX2
+} cpu_level_t;
+
+/**
+ * @brief best instruction set level usable by the kernels
+ *
+ * detected once at startup. the ISENCHEF_SIMD environment variable
+ * (scalar, sse2, ssse3, avx2) can lower it, never raise it.
+ *
+ * @return detected level
+ */
+cpu_level_t cpu_level(void);
+
+/**
+ * @brief change the level used by the kernels, to compare them with each other
+ * @param level wanted level, must not be above the detected one
+ * @return 0 on success, -1 if the cpu does not support the level
+ */
+int cpu_set_level(cpu_level_t level);
+
+/**
+ * @brief highest level the cpu supports, whatever cpu_set_level chose
+ * @return supported level
+ */
+cpu_level_t cpu_supported_level(void);
+
+/**
+ * @brief tell whether the crc32c kernel can run (sse4.2 crc32 instruction)
+ *
+ * follows the chosen level: forcing scalar turns it off too.
+ *
+ * @return non-zero when it can
+ */
+int cpu_has_crc32c(void);
+
+/**
+ * @brief tell whether the sha-256 kernel can run (sha extensions)
+ * @return non-zero when it can
+ */
+int cpu_has_sha256(void);
+
+/**
+ * @brief printable name of a level
+ * @param level instruction set level
+ * @return static string
+ */
+const char *cpu_level_name(cpu_level_t level);
+
+#endif /* CPU_H */
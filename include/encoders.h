@@ -14,10 +14,38 @@
  * @param hex input hex string (null-terminated)
  * @param output output buffer
  * @param output_size output buffer size
- * @return number of bytes decoded, or -1 on error
+ * @return number of bytes decoded, or -1 on error or past INT_MAX bytes
  */
 int decode_hex(const char *hex, uint8_t *output, size_t output_size);
 
+/**
+ * @brief decode hex digits that are not nul-terminated
+ * @param hex input hex digits, a nul is an invalid character
+ * @param hex_len number of characters
+ * @param output output buffer
+ * @param output_size output buffer size
+ * @param decoded set to the number of bytes decoded
+ * @return 0 on success, -1 on error
+ */
+int decode_hex_len(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                   size_t *decoded);
+
+/**
+ * @brief decode a whole hex text, split across the workers when it is large
+ *
+ * slices start on an even digit count so each worker decodes straight into
+ * its own part of output. the text and output must not overlap.
+ *
+ * @param hex input characters
+ * @param hex_len number of characters
+ * @param output output buffer, at least (hex_len + 1) / 2 bytes
+ * @param output_size output buffer size
+ * @param decoded set to the number of bytes decoded
+ * @return 0 on success, -1 on invalid input
+ */
+int decode_hex_all(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                   size_t *decoded);
+
 /**
  * @brief encode bytes to hex string
  * @param input input bytes
@@ -32,19 +60,116 @@ int encode_hex(const uint8_t *input, size_t input_size, char *output);
  * @param base64 input base64 string (null-terminated)
  * @param output output buffer
  * @param output_size output buffer size
- * @return number of bytes decoded, or -1 on error
+ * @return number of bytes decoded, or -1 on error or past INT_MAX bytes
  */
 int decode_base64(const char *base64, uint8_t *output, size_t output_size);
 
+/**
+ * @brief decode base64 characters that are not nul-terminated
+ * @param base64 input characters, a nul is an invalid character
+ * @param base64_len number of characters
+ * @param output output buffer
+ * @param output_size output buffer size
+ * @param decoded set to the number of bytes decoded
+ * @return 0 on success, -1 on error
+ */
+int decode_base64_len(const char *base64, size_t base64_len, uint8_t *output,
+                      size_t output_size, size_t *decoded);
+
+/**
+ * @brief decode a whole base64 text, split across the workers when it is large
+ *
+ * slices start on a multiple of 4 significant characters so each worker
+ * decodes straight into its own part of output. the text and output must
+ * not overlap.
+ *
+ * @param base64 input characters
+ * @param base64_len number of characters
+ * @param output output buffer, at least base64_len / 4 * 3 + 3 bytes
+ * @param output_size output buffer size
+ * @param decoded set to the number of bytes decoded
+ * @return 0 on success, -1 on invalid input
+ */
+int decode_base64_all(const char *base64, size_t base64_len, uint8_t *output,
+                      size_t output_size, size_t *decoded);
+
 /**
  * @brief encode bytes to base64 string
  * @param input input bytes
  * @param input_size number of bytes
  * @param output output base64 string buffer
  * @param output_size output buffer size
- * @return number of characters written, or -1 on error
+ * @param encoded set to the number of characters written, without the terminator
+ * @return 0 on success, -1 on error
+ */
+int encode_base64(const uint8_t *input, size_t input_size, char *output, size_t output_size,
+                  size_t *encoded);
+
+/*
+ * incremental codecs, for input that arrives in pieces.
+ *
+ * update works through as much input as the output has room for and
+ * reports how much of each it used, the caller passes the rest again with
+ * more room. final flushes what is held back at the end of the input.
+ * partial hex pairs, base64 quads and padding are carried between calls,
+ * totals are kept in 64 bits. update and final return 0, or -1 on an
+ * invalid character (decoders) or an output too small for final.
  */
-int encode_base64(const uint8_t *input, size_t input_size, char *output, size_t output_size);
+
+typedef struct {
+    int high;           /* pending high nibble, -1 if none */
+    uint64_t consumed;  /* characters read so far */
+    uint64_t produced;  /* bytes written so far */
+} hex_decoder_t;
+
+typedef struct {
+    uint32_t bits;      /* 6-bit groups not yet turned into bytes */
+    int bit_count;      /* number of pending bits */
+    int padded;         /* '=' seen, the rest of the input is ignored */
+    uint64_t consumed;
+    uint64_t produced;
+} base64_decoder_t;
+
+typedef struct {
+    uint64_t consumed;  /* bytes read so far */
+    uint64_t produced;  /* characters written so far */
+} hex_encoder_t;
+
+typedef struct {
+    uint8_t tail[3];    /* bytes short of a whole triple */
+    size_t tail_len;
+    uint64_t consumed;
+    uint64_t produced;
+} base64_encoder_t;
+
+void hex_decoder_init(hex_decoder_t *decoder);
+int hex_decoder_update(hex_decoder_t *decoder, const char *input, size_t input_len,
+                       uint8_t *output, size_t output_size, size_t *consumed, size_t *produced);
+/* an odd digit left over becomes a byte padded with 0, it needs one byte of room */
+int hex_decoder_final(hex_decoder_t *decoder, uint8_t *output, size_t output_size,
+                      size_t *produced);
+
+void base64_decoder_init(base64_decoder_t *decoder);
+int base64_decoder_update(base64_decoder_t *decoder, const char *input, size_t input_len,
+                          uint8_t *output, size_t output_size, size_t *consumed,
+                          size_t *produced);
+/* bits short of a byte are dropped, nothing is written */
+int base64_decoder_final(base64_decoder_t *decoder, uint8_t *output, size_t output_size,
+                         size_t *produced);
+
+void hex_encoder_init(hex_encoder_t *encoder);
+int hex_encoder_update(hex_encoder_t *encoder, const uint8_t *input, size_t input_size,
+                       char *output, size_t output_size, size_t *consumed, size_t *produced);
+int hex_encoder_final(hex_encoder_t *encoder, char *output, size_t output_size,
+                      size_t *produced);
+
+void base64_encoder_init(base64_encoder_t *encoder);
+int base64_encoder_update(base64_encoder_t *encoder, const uint8_t *input, size_t input_size,
+                          char *output, size_t output_size, size_t *consumed,
+                          size_t *produced);
+/* the last partial triple becomes a padded quad, it needs four characters of room */
+int base64_encoder_final(base64_encoder_t *encoder, char *output, size_t output_size,
+                         size_t *produced);
 
 #endif /* ENCODERS_H */
 
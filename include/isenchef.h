@@ -6,6 +6,7 @@
 #ifndef ISENCHEF_H
 #define ISENCHEF_H
 
+#include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -29,22 +30,78 @@ typedef enum {
     ACTION_XOR
 } action_t;
 
+/* one action of a recipe, with its parameter */
+typedef struct {
+    action_t action;
+    char *param;
+    int param_hex;  /* param holds hex digits of a binary key */
+    size_t drop;    /* rc4 keystream bytes discarded before use (rc4-drop[n]) */
+} recipe_step_t;
+
+/* one destination of the result, --out <file>[:<format>] */
+typedef struct {
+    char *file;
+    format_t format;
+    int format_given;  /* :<format> was given, otherwise --output-format applies */
+} output_sink_t;
+
+/* one --checksum <algorithm>[:<point>], CHECKSUM_* values from checksum.h */
+typedef struct {
+    int algorithm;
+    int point;
+} checksum_spec_t;
+
 /* configuration structure */
 typedef struct {
     char *input_file;
-    char *output_file;
+    char *output_file;   /* the first --out */
     format_t input_format;
     format_t output_format;
     action_t action;
     char *action_param;  /* for xor key, caesar shift, rc4 key, etc. */
+    int action_param_hex;  /* action_param was given as hex (--xor-key-hex) */
+    size_t rc4_drop;       /* --rc4-drop, keystream bytes to skip */
+    int streaming;       /* process the file chunk by chunk instead of loading it */
+    size_t chunk_size;   /* bytes read per chunk in streaming mode */
+    int mapped;          /* map files instead of copying them (bytes only) */
+    int in_place;        /* transform the input file where it is */
+    int threads;         /* worker threads for position-independent work, 0 = one per cpu */
+    char *batch_file;    /* manifest of jobs, one command line per line */
+    char *batch_dir;     /* directory walked recursively, every file is a job */
+    char *serve_socket;  /* unix socket to serve requests on (--serve) */
+    int stats;           /* --stats report style, STATS_OFF/TEXT/JSON from stats.h */
+    int io_backend;      /* --io, IO_AUTO/URING/THREADS/SYNC from async_io.h */
+    int direct;          /* --direct, write the output around the page cache */
+    int records;         /* --records, RECORDS_NONE/LINES/LENGTH from records.h */
+    int analyze;         /* --analyze, ANALYZE_NONE/CAESAR/XOR/ALL from analyze.h */
+    size_t max_key_length;  /* --max-key-length, longest repeating xor key tried */
+    recipe_step_t *steps;  /* actions to apply in order (--action or --recipe) */
+    size_t step_count;
+    char *recipe_text;     /* owned copy of --recipe the step params point into */
+    output_sink_t *outputs;  /* every --out, more than one fans the result out */
+    size_t output_count;
+    checksum_spec_t *checksums;  /* --checksum, taken while the data goes through */
+    size_t checksum_count;
+    char *checksum_file;   /* --checksum-file, sidecar the sums are appended to */
 } config_t;
 
 /* data buffer structure */
 typedef struct {
     uint8_t *data;
     size_t size;
+    size_t capacity;  /* of data when it comes from the buffer pool, 0 for malloc or a view */
 } buffer_t;
 
+/* buffers kept from one job to the next so a batch does not allocate per file, from the pool */
+typedef struct {
+    char *text;           /* encoded input, decoded over itself */
+    size_t text_size;
+    uint8_t *data;        /* raw input of bytes-format files */
+    size_t data_size;
+    char *encoded;        /* encoded output */
+    size_t encoded_size;
+} io_scratch_t;
+
 /**
  * @brief parse command line arguments
  * @param argc argument count
@@ -54,12 +111,101 @@ typedef struct {
  */
 int parse_arguments(int argc, char *argv[], config_t *config);
 
+/**
+ * @brief split a recipe "step[:param],..." into config->steps
+ *
+ * from_hex/from_base64 and to_hex/to_base64 set the input and output
+ * formats. the steps point into config->recipe_text, free_config releases
+ * both.
+ *
+ * @param recipe recipe text
+ * @param config configuration to fill, zeroed by the caller
+ * @return 0 on success, -1 on error
+ */
+int parse_recipe(const char *recipe, config_t *config);
+
+/**
+ * @brief split a command line held in one string, in place
+ *
+ * words are separated by blanks, single or double quotes group words
+ * containing blanks. argv[0] is set to a program name so the result can
+ * go straight to parse_arguments.
+ *
+ * @param line text to split, modified
+ * @param argc set to the number of entries
+ * @return NULL-terminated argument vector to free(), NULL on error
+ */
+char **split_arguments(char *line, int *argc);
+
 /**
  * @brief free configuration resources
  * @param config configuration structure
  */
 void free_config(config_t *config);
 
+/**
+ * @brief print an error message to stderr, and keep it for last_error_message
+ * @param format printf format, a trailing newline is dropped from the kept copy
+ */
+void report_error(const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
+
+/**
+ * @brief stop report_error from printing on the calling thread, or let it again
+ * @param quiet non-zero to keep the messages only
+ * @return previous setting, to restore afterwards
+ */
+int quiet_errors_set(int quiet);
+
+/**
+ * @brief last message given to report_error on the calling thread
+ * @return message without the newline, "" if none
+ */
+const char *last_error_message(void);
+
+/**
+ * @brief tell whether a file name is "-", standing for stdin or stdout
+ * @param filename file name
+ * @return non-zero for "-"
+ */
+int is_stdio_path(const char *filename);
+
+/**
+ * @brief open a file for binary reading, "-" gives stdin
+ * @param filename file name
+ * @return stream, NULL on error (errno set)
+ */
+FILE *open_input(const char *filename);
+
+/**
+ * @brief open a file for binary writing, "-" gives stdout
+ * @param filename file name
+ * @return stream, NULL on error (errno set)
+ */
+FILE *open_output(const char *filename);
+
+/**
+ * @brief tell whether an output name is the file an input stream reads
+ *
+ * jobs that write while they read must check this before open_output
+ * truncates their input.
+ *
+ * @param in stream from open_input
+ * @param output output file name, "-" is never the input
+ * @return non-zero when both are the same file
+ */
+int output_is_input(FILE *in, const char *output);
+
+/**
+ * @brief close a stream from open_input/open_output, stdin and stdout stay open
+ * @param file stream
+ * @return 0 on success, EOF when pending output could not be written
+ */
+int close_file(FILE *file);
+
 /**
  * @brief read file and decode according to input format
  * @param filename input filename
@@ -69,6 +215,52 @@ void free_config(config_t *config);
  */
 int read_file(const char *filename, format_t format, buffer_t *buffer);
 
+/**
+ * @brief make room for size characters of input (and a terminator) in scratch->text
+ * @param scratch scratch buffers
+ * @param size number of characters
+ * @return scratch->text, NULL on error
+ */
+char *scratch_text(io_scratch_t *scratch, size_t size);
+
+/**
+ * @brief decode the input held in scratch->text, in place
+ *
+ * the decoded data replaces the text at the front of the same buffer,
+ * which is then shrunk when that frees a large tail. a large text with
+ * several workers is decoded in parallel into scratch->data instead.
+ *
+ * @param format input format, bytes uses the text as it is
+ * @param text_len number of characters in scratch->text
+ * @param buffer filled with a view into scratch, not to be freed
+ * @param scratch scratch buffers
+ * @return 0 on success, -1 on error
+ */
+int decode_scratch(format_t format, size_t text_len, buffer_t *buffer, io_scratch_t *scratch);
+
+/**
+ * @brief encode a buffer for output into scratch->encoded
+ * @param format output format, bytes gives the buffer itself
+ * @param buffer data to encode
+ * @param scratch scratch buffers
+ * @param output set to the data to write
+ * @param output_size set to the number of bytes to write
+ * @return 0 on success, -1 on error
+ */
+int encode_scratch(format_t format, const buffer_t *buffer, io_scratch_t *scratch,
+                   const void **output, size_t *output_size);
+
+/**
+ * @brief like read_file, decoding into scratch buffers that are reused
+ * @param filename input filename
+ * @param format input format
+ * @param buffer filled with a view into scratch, not to be freed
+ * @param scratch buffers grown as needed
+ * @return 0 on success, -1 on error
+ */
+int read_file_scratch(const char *filename, format_t format, buffer_t *buffer,
+                      io_scratch_t *scratch);
+
 /**
  * @brief encode buffer and write to file
  * @param filename output filename
@@ -78,11 +270,33 @@ int read_file(const char *filename, format_t format, buffer_t *buffer);
  */
 int write_file(const char *filename, format_t format, const buffer_t *buffer);
 
+/**
+ * @brief like write_file, encoding into scratch buffers that are reused
+ *
+ * files get their final size allocated before the data is written, in
+ * large blocks.
+ *
+ * @param filename output filename
+ * @param format output format
+ * @param buffer input buffer structure
+ * @param scratch buffers grown as needed
+ * @param direct write around the page cache (O_DIRECT) where the file system allows it
+ * @return 0 on success, -1 on error
+ */
+int write_file_scratch(const char *filename, format_t format, const buffer_t *buffer,
+                       io_scratch_t *scratch, int direct);
+
 /**
  * @brief free buffer resources
  * @param buffer buffer structure
  */
 void free_buffer(buffer_t *buffer);
 
+/**
+ * @brief free scratch buffers
+ * @param scratch scratch buffers
+ */
+void free_scratch(io_scratch_t *scratch);
+
 #endif /* ISENCHEF_H */
 
@@ -0,0 +1,163 @@
+/**
+ * @file libisenchef.h
+ * @brief embeddable api: codecs and recipes on caller buffers
+ *
+ * every function works on buffers owned by the caller and can be called
+ * from any number of threads. a context holds the state of one recipe and
+ * must only be used by one thread at a time. nothing here allocates except
+ * isenchef_ctx_new, so a loop over contexts made up front runs without
+ * touching the heap. errors are returned, never printed.
+ *
+ * the size functions give the room an output needs, text outputs include
+ * one byte for the terminating nul that is always written.
+ */
+
+#ifndef LIBISENCHEF_H
+#define LIBISENCHEF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define ISENCHEF_API __attribute__((visibility("default")))
+#else
+#define ISENCHEF_API
+#endif
+
+/* return codes */
+#define ISENCHEF_OK 0
+#define ISENCHEF_ERROR (-1)     /* invalid input, key or recipe */
+#define ISENCHEF_NO_SPACE (-2)  /* output smaller than the matching size function asks for */
+
+/* same values as the command line formats */
+typedef enum {
+    ISENCHEF_BYTES,
+    ISENCHEF_HEX,
+    ISENCHEF_BASE64
+} isenchef_format_t;
+
+typedef struct isenchef_ctx isenchef_ctx_t;
+
+/**
+ * @brief room needed to encode size bytes
+ * @param format output format
+ * @param size number of bytes
+ * @return bytes of output, with the nul for text formats
+ */
+ISENCHEF_API size_t isenchef_encoded_size(isenchef_format_t format, size_t size);
+
+/**
+ * @brief room needed to decode length characters, an upper bound
+ * @param format input format
+ * @param length number of characters
+ * @return bytes of output
+ */
+ISENCHEF_API size_t isenchef_decoded_size(isenchef_format_t format, size_t length);
+
+/**
+ * @brief encode bytes
+ * @param format output format
+ * @param input bytes to encode
+ * @param size number of bytes
+ * @param output output buffer
+ * @param output_size output buffer size
+ * @param written set to the bytes written, nul excluded
+ * @return ISENCHEF_OK, or a negative error code
+ */
+ISENCHEF_API int isenchef_encode(isenchef_format_t format, const uint8_t *input, size_t size,
+                                 char *output, size_t output_size, size_t *written);
+
+/**
+ * @brief decode text, whitespace is skipped like on the command line
+ * @param format input format
+ * @param input characters, no terminator needed
+ * @param length number of characters
+ * @param output output buffer
+ * @param output_size output buffer size
+ * @param written set to the bytes decoded
+ * @return ISENCHEF_OK, or a negative error code
+ */
+ISENCHEF_API int isenchef_decode(isenchef_format_t format, const char *input, size_t length,
+                                 uint8_t *output, size_t output_size, size_t *written);
+
+/**
+ * @brief build a context for a recipe, in --recipe syntax
+ *
+ * from_hex/from_base64 and to_hex/to_base64 set the formats of
+ * isenchef_ctx_transform, key schedules are done here once.
+ *
+ * @param recipe recipe text, NULL or "" for no steps
+ * @return new context, NULL on error
+ */
+ISENCHEF_API isenchef_ctx_t *isenchef_ctx_new(const char *recipe);
+
+/**
+ * @brief why the last isenchef_ctx_new of the calling thread returned NULL
+ *
+ * nothing is printed by the library, the recipe and key errors the
+ * command line shows on stderr are kept here instead. a failed
+ * isenchef_ctx_reset leaves its reason here too, invalid encoded input
+ * does not.
+ *
+ * @return message, "" if none, valid until the thread's next library call
+ */
+ISENCHEF_API const char *isenchef_last_error(void);
+
+/**
+ * @brief free a context
+ * @param ctx context, may be NULL
+ */
+ISENCHEF_API void isenchef_ctx_free(isenchef_ctx_t *ctx);
+
+/**
+ * @brief rewind the recipe state (rc4 keystream, xor key position)
+ * @param ctx context
+ * @return ISENCHEF_OK, or a negative error code
+ */
+ISENCHEF_API int isenchef_ctx_reset(isenchef_ctx_t *ctx);
+
+/**
+ * @brief apply the recipe steps in place, carrying on from the previous call
+ *
+ * formats are ignored, this is for data arriving in pieces.
+ *
+ * @param ctx context
+ * @param data data to transform
+ * @param size number of bytes
+ * @return ISENCHEF_OK, or a negative error code
+ */
+ISENCHEF_API int isenchef_ctx_apply(isenchef_ctx_t *ctx, uint8_t *data, size_t size);
+
+/**
+ * @brief room isenchef_ctx_transform needs for an input, an upper bound
+ * @param ctx context
+ * @param size input size
+ * @return bytes of output
+ */
+ISENCHEF_API size_t isenchef_ctx_output_size(const isenchef_ctx_t *ctx, size_t size);
+
+/**
+ * @brief run a whole message through the recipe: decode, steps, encode
+ *
+ * the context is reset first, so each message starts a new keystream.
+ *
+ * @param ctx context
+ * @param input message in the recipe's input format
+ * @param size input size
+ * @param output output buffer, must not overlap the input
+ * @param output_size output buffer size
+ * @param written set to the bytes written, nul excluded
+ * @return ISENCHEF_OK, or a negative error code
+ */
+ISENCHEF_API int isenchef_ctx_transform(isenchef_ctx_t *ctx, const void *input, size_t size,
+                                        void *output, size_t output_size, size_t *written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBISENCHEF_H */
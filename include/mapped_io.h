@@ -0,0 +1,28 @@
+/**
+ * @file mapped_io.h
+ * @brief memory-mapped zero-copy path for raw byte jobs
+ */
+
+#ifndef MAPPED_IO_H
+#define MAPPED_IO_H
+
+#include "isenchef.h"
+#include "checksum.h"
+
+/**
+ * @brief process a bytes -> bytes configuration through memory mappings
+ *
+ * the input file is mapped read-only and the output file is sized and
+ * mapped shared, the action then reads from one mapping and writes into
+ * the other. with config->in_place (or when both names refer to the same
+ * file) the input is mapped writable and transformed where it is. an
+ * output of "-" gets a private writable mapping of the input, transformed
+ * in place and handed to stdout (with vmsplice when it is a pipe).
+ *
+ * @param config configuration (both formats must be FORMAT_BYTES)
+ * @param sums checksums fed as the data goes through, may be NULL
+ * @return 0 on success, -1 on error
+ */
+int mapped_execute(const config_t *config, checksum_set_t *sums);
+
+#endif /* MAPPED_IO_H */
@@ -0,0 +1,31 @@
+/**
+ * @file passthrough.h
+ * @brief copy of untouched data from input to output, in the kernel when possible
+ */
+
+#ifndef PASSTHROUGH_H
+#define PASSTHROUGH_H
+
+#include "isenchef.h"
+
+/**
+ * @brief tell whether a configuration leaves its data untouched
+ * @param config configuration
+ * @return non-zero for bytes -> bytes without any step
+ */
+int passthrough_applies(const config_t *config);
+
+/**
+ * @brief copy the input to the output unchanged
+ *
+ * on linux the data goes through splice when either end is a pipe and
+ * through sendfile otherwise, so it never crosses into user space. a
+ * read/write loop is used where neither is supported. input and output
+ * naming the same file leave it as it is.
+ *
+ * @param config configuration, "-" names stdin or stdout
+ * @return 0 on success, -1 on error
+ */
+int passthrough_execute(const config_t *config);
+
+#endif /* PASSTHROUGH_H */
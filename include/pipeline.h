@@ -0,0 +1,126 @@
+/**
+ * @file pipeline.h
+ * @brief ordered chain of actions applied block by block
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "isenchef.h"
+#include "actions.h"
+#include "bytemap.h"
+#include "xor.h"
+#include "rc4.h"
+#include "checksum.h"
+
+/* data goes through every step one block at a time, while it is still in cache */
+#define PIPELINE_BLOCK_SIZE (64 * 1024)
+
+typedef enum {
+    STAGE_ACTION,  /* runs one recipe action */
+    STAGE_BYTEMAP  /* consecutive substitution actions compiled into one table */
+} stage_kind_t;
+
+/* one step with the state it keeps between calls */
+typedef struct {
+    stage_kind_t kind;
+    action_t action;
+    const char *param;
+    int shift;
+    rc4_state_t rc4;
+    rc4_state_t rc4_key;       /* state right after the key schedule, for pipeline_reset */
+    rc4_stream_t *rc4_stream;  /* keystream thread, NULL when rc4 runs inline */
+    xor_key_t xor;
+    bytemap_t map;
+} pipeline_stage_t;
+
+typedef struct {
+    pipeline_stage_t *stages;
+    size_t count;
+    uint64_t offset;  /* bytes processed so far, selects the xor key byte */
+    int position_independent;  /* no stage carries state from byte to byte (no rc4) */
+} pipeline_t;
+
+/**
+ * @brief prepare the stages of a recipe (key schedules, parsed shifts)
+ *
+ * runs of caesar/uppercase/lowercase steps are folded into a single byte
+ * map stage, so the chain costs one table lookup per byte.
+ *
+ * @param pipeline pipeline to initialize
+ * @param steps recipe steps (kept by reference)
+ * @param count number of steps, may be 0
+ * @return 0 on success, -1 on error
+ */
+int pipeline_init(pipeline_t *pipeline, const recipe_step_t *steps, size_t count);
+
+/**
+ * @brief apply every step to the next part of the data, in place
+ *
+ * calls continue where the previous one stopped, so the data can be fed
+ * in pieces of any size. large buffers are split across the worker pool
+ * when no stage depends on the bytes before it.
+ *
+ * @param pipeline initialized pipeline
+ * @param data data buffer
+ * @param size buffer size
+ * @return 0 on success, -1 on error
+ */
+int pipeline_run(pipeline_t *pipeline, uint8_t *data, size_t size);
+
+/**
+ * @brief like pipeline_run, reading from src and writing to dst
+ * @param pipeline initialized pipeline
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @return 0 on success, -1 on error
+ */
+int pipeline_run_copy(pipeline_t *pipeline, const uint8_t *src, uint8_t *dst, size_t size);
+
+/**
+ * @brief like pipeline_run_copy, feeding checksums on the way
+ *
+ * with sums reading the decoded or transformed data, the data goes through
+ * one block at a time: each block is hashed before and after the steps
+ * while it is in cache. such runs are not split across the workers.
+ *
+ * @param pipeline initialized pipeline
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @param sums checksums of the job, may be NULL
+ * @return 0 on success, -1 on error
+ */
+int pipeline_run_summed(pipeline_t *pipeline, const uint8_t *src, uint8_t *dst, size_t size,
+                        checksum_set_t *sums);
+
+/**
+ * @brief rewind the pipeline to the start of a new stream
+ *
+ * key schedules are kept, so a recipe used for many short messages only
+ * pays for them once.
+ *
+ * @param pipeline initialized pipeline
+ * @return 0 on success, -1 on error
+ */
+int pipeline_reset(pipeline_t *pipeline);
+
+/**
+ * @brief run every stage on the calling thread, without keystream threads
+ *
+ * for pipelines reset before every short message, where restarting an rc4
+ * keystream thread each time would cost more than it saves. must be
+ * called before any data goes through.
+ *
+ * @param pipeline initialized pipeline
+ */
+void pipeline_inline(pipeline_t *pipeline);
+
+/**
+ * @brief free pipeline resources
+ * @param pipeline pipeline structure
+ */
+void pipeline_free(pipeline_t *pipeline);
+
+#endif /* PIPELINE_H */
@@ -10,5 +10,13 @@
  */
 int execute_config(const config_t *config);
 
+/**
+ * @brief run one job without printing its status, reusing scratch buffers
+ * @param config job configuration
+ * @param scratch buffers kept between jobs
+ * @return 0 on success, -1 on error
+ */
+int execute_job(const config_t *config, io_scratch_t *scratch);
+
 #endif /* PROCESSOR_H */
 
@@ -0,0 +1,83 @@
+/**
+ * @file rc4.h
+ * @brief rc4 stream cipher, inline or with the keystream made on its own thread
+ */
+
+#ifndef RC4_H
+#define RC4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* rc4 cipher state, kept between calls when data arrives in pieces */
+typedef struct {
+    uint8_t S[256];
+    uint8_t i;
+    uint8_t j;
+} rc4_state_t;
+
+/* keystream produced ahead of use by a background thread */
+typedef struct rc4_stream rc4_stream_t;
+
+/**
+ * @brief run the rc4 key schedule
+ * @param state cipher state to initialize
+ * @param key key bytes
+ * @param key_len number of key bytes, must not be 0
+ * @param drop keystream bytes to discard first (rc4-drop[n]), 0 for plain rc4
+ * @return 0 on success, -1 on error
+ */
+int rc4_init(rc4_state_t *state, const uint8_t *key, size_t key_len, size_t drop);
+
+/**
+ * @brief write the next keystream bytes
+ * @param state cipher state from rc4_init
+ * @param out keystream output
+ * @param size number of bytes
+ */
+void rc4_keystream(rc4_state_t *state, uint8_t *out, size_t size);
+
+/**
+ * @brief apply the rc4 keystream, continuing where the previous call stopped
+ * @param state cipher state from rc4_init
+ * @param data data buffer
+ * @param size buffer size
+ */
+void rc4_process(rc4_state_t *state, uint8_t *data, size_t size);
+
+/**
+ * @brief apply the rc4 keystream while copying src to dst
+ * @param state cipher state from rc4_init
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ */
+void rc4_process_copy(rc4_state_t *state, const uint8_t *src, uint8_t *dst, size_t size);
+
+/**
+ * @brief start a thread that fills a ring buffer with keystream
+ *
+ * the thread runs ahead of the data by a few blocks, so reading, decoding
+ * and encoding on the caller side overlap with keystream generation.
+ *
+ * @param state cipher state to continue from (copied)
+ * @return stream handle, NULL on error
+ */
+rc4_stream_t *rc4_stream_start(const rc4_state_t *state);
+
+/**
+ * @brief apply the next keystream bytes from the ring while copying src to dst
+ * @param stream stream from rc4_stream_start
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ */
+void rc4_stream_apply(rc4_stream_t *stream, const uint8_t *src, uint8_t *dst, size_t size);
+
+/**
+ * @brief stop the keystream thread and free the stream
+ * @param stream stream from rc4_stream_start, may be NULL
+ */
+void rc4_stream_stop(rc4_stream_t *stream);
+
+#endif /* RC4_H */
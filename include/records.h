@@ -0,0 +1,31 @@
+/**
+ * @file records.h
+ * @brief record-oriented mode, every line or length-prefixed record transformed on its own
+ */
+
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include "isenchef.h"
+
+/* --records modes, stored in config_t.records */
+#define RECORDS_NONE 0
+#define RECORDS_LINES 1   /* one record per line, a trailing \r is dropped */
+#define RECORDS_LENGTH 2  /* 4-byte big-endian length, then the record */
+
+/* input read per batch, a longer record grows the batch to fit */
+#define RECORDS_BATCH (8 * 1024 * 1024)
+
+/**
+ * @brief decode, transform and encode every record of the input separately
+ *
+ * each record starts from a fresh pipeline (rc4 from its key, xor from the
+ * first key byte). records are read in batches whose records are shared
+ * out to the workers, and written in input order with the same framing.
+ *
+ * @param config configuration, records is RECORDS_LINES or RECORDS_LENGTH
+ * @return 0 on success, -1 on error
+ */
+int records_execute(const config_t *config);
+
+#endif /* RECORDS_H */
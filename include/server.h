@@ -0,0 +1,54 @@
+/**
+ * @file server.h
+ * @brief warm daemon answering transform requests on a unix socket, and its client
+ *
+ * every message starts with a fixed header in network byte order.
+ *
+ * request:  u32 flags, u32 args length, u64 payload length, args, payload
+ * response: u32 status (0 ok), u64 body length, body
+ *
+ * args is a command line like a batch manifest line. with SERVER_INLINE
+ * the payload is the input and the body of the response is the output,
+ * formats and steps come from args. without it args must name --in and
+ * --out files (absolute paths), the payload is empty and the body is a
+ * status message.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "isenchef.h"
+
+/* request flag: the input travels in the payload, the output in the response */
+#define SERVER_INLINE 1u
+
+#define SERVER_MAX_ARGS (64 * 1024)
+#define SERVER_MAX_PAYLOAD ((uint64_t)1 << 30)
+
+/**
+ * @brief serve requests on config->serve_socket until SIGINT or SIGTERM
+ *
+ * config->threads threads (0 = one per cpu) accept connections, each with
+ * buffers kept from one request to the next. a connection keeps the
+ * pipeline of its last inline recipe, so repeated requests with the same
+ * keys skip the key schedules.
+ *
+ * @param config server configuration
+ * @return 0 on success, -1 on error
+ */
+int serve_execute(const config_t *config);
+
+/**
+ * @brief send one job to a running server
+ *
+ * without --in the input is read from stdin and the output written to
+ * stdout. with --in/--out the server works on the files directly,
+ * relative paths are resolved against the current directory first.
+ *
+ * @param argc number of arguments
+ * @param argv socket path followed by the job options
+ * @return 0 on success, -1 on error
+ */
+int client_main(int argc, char *argv[]);
+
+#endif /* SERVER_H */
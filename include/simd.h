@@ -0,0 +1,151 @@
+/**
+ * @file simd.h
+ * @brief vectorized kernels behind the codecs and actions, selected through cpu_level()
+ *
+ * kernels only handle whole blocks and report how far they got, the scalar
+ * code finishes the tail so both paths give the same output.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cpu.h"
+
+/* hex decoder position, shared by the kernels and the scalar tail */
+typedef struct {
+    size_t in;   /* characters consumed */
+    size_t out;  /* bytes produced */
+    int high;    /* pending high nibble, -1 if none */
+} hex_cursor_t;
+
+/* base64 decoder position, shared by the kernels and the scalar tail */
+typedef struct {
+    size_t in;      /* characters consumed */
+    size_t out;     /* bytes produced */
+    uint32_t bits;  /* 6-bit groups not yet turned into bytes */
+    int bit_count;  /* number of pending bits */
+} base64_cursor_t;
+
+#ifdef ISENCHEF_X86
+
+/* pshufb indices that move the bytes selected by an 8-bit mask to the front */
+extern uint8_t simd_pack_table[256][8];
+
+/**
+ * @brief encode whole blocks of bytes to lowercase hex
+ * @param input input bytes
+ * @param input_size number of bytes
+ * @param output output buffer (input_size * 2 characters)
+ * @return number of input bytes encoded, the caller encodes the rest
+ */
+size_t hex_encode_sse2(const uint8_t *input, size_t input_size, char *output);
+size_t hex_encode_ssse3(const uint8_t *input, size_t input_size, char *output);
+size_t hex_encode_avx2(const uint8_t *input, size_t input_size, char *output);
+
+/**
+ * @brief decode whole blocks of hex characters, skipping whitespace
+ * @param hex input characters
+ * @param hex_len number of characters
+ * @param output output buffer
+ * @param output_size output buffer size
+ * @param cursor position to start from, updated on return
+ * @return 0 on success, -1 on an invalid character
+ */
+int hex_decode_sse2(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                    hex_cursor_t *cursor);
+int hex_decode_ssse3(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                     hex_cursor_t *cursor);
+int hex_decode_avx2(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                    hex_cursor_t *cursor);
+
+/**
+ * @brief encode whole blocks of bytes to base64
+ * @param input input bytes
+ * @param input_size number of bytes
+ * @param output output buffer (room for the whole encoded input)
+ * @return number of input bytes encoded (a multiple of 3), the caller encodes the rest
+ */
+size_t base64_encode_ssse3(const uint8_t *input, size_t input_size, char *output);
+size_t base64_encode_avx2(const uint8_t *input, size_t input_size, char *output);
+
+/**
+ * @brief decode whole blocks of base64 characters, skipping whitespace
+ *
+ * stops at the first padding or invalid character, the scalar decoder
+ * then reports the error or finishes the input.
+ *
+ * @param base64 input characters
+ * @param base64_len number of characters
+ * @param output output buffer
+ * @param output_size output buffer size
+ * @param cursor position to start from, updated on return
+ */
+void base64_decode_ssse3(const char *base64, size_t base64_len, uint8_t *output,
+                         size_t output_size, base64_cursor_t *cursor);
+void base64_decode_avx2(const char *base64, size_t base64_len, uint8_t *output,
+                        size_t output_size, base64_cursor_t *cursor);
+
+/**
+ * @brief apply a 256-entry byte map to whole blocks
+ * @param table map, table[b] replaces byte b
+ * @param rows bit n set when row n (bytes n*16 .. n*16+15) is not the identity
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @return number of bytes mapped, the caller maps the rest
+ */
+size_t bytemap_apply_ssse3(const uint8_t table[256], uint16_t rows, const uint8_t *src,
+                           uint8_t *dst, size_t size);
+size_t bytemap_apply_avx2(const uint8_t table[256], uint16_t rows, const uint8_t *src,
+                          uint8_t *dst, size_t size);
+
+/**
+ * @brief xor whole vectors with a repeated key pattern
+ * @param pattern key repeated over length + XOR_MAX_WIDTH bytes
+ * @param length key period
+ * @param phase key position of src[0] (less than length)
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @return number of bytes processed, the caller finishes the rest
+ */
+size_t xor_apply_sse2(const uint8_t *pattern, size_t length, size_t phase,
+                      const uint8_t *src, uint8_t *dst, size_t size);
+size_t xor_apply_avx2(const uint8_t *pattern, size_t length, size_t phase,
+                      const uint8_t *src, uint8_t *dst, size_t size);
+
+/**
+ * @brief add whole 8-byte words to a crc32c with the sse4.2 crc32 instruction
+ * @param crc running crc (pre-inverted), updated
+ * @param data bytes
+ * @param size number of bytes
+ * @return number of bytes added, the caller adds the rest
+ */
+size_t crc32c_sse42(uint32_t *crc, const uint8_t *data, size_t size);
+
+/**
+ * @brief count the bits that differ between two byte runs, whole blocks only
+ * @param a first run
+ * @param b second run, may overlap a
+ * @param size number of bytes of each run
+ * @param bits incremented by the count
+ * @return number of bytes compared, the caller compares the rest
+ */
+size_t hamming_ssse3(const uint8_t *a, const uint8_t *b, size_t size, uint64_t *bits);
+size_t hamming_avx2(const uint8_t *a, const uint8_t *b, size_t size, uint64_t *bits);
+
+/**
+ * @brief run the sha-256 compression function over whole blocks with the sha extensions
+ * @param h hash state, updated
+ * @param k the 64 round constants
+ * @param data input blocks
+ * @param blocks number of 64-byte blocks
+ * @return number of blocks processed
+ */
+size_t sha256_shani(uint32_t h[8], const uint32_t k[64], const uint8_t *data, size_t blocks);
+
+#endif /* ISENCHEF_X86 */
+
+#endif /* SIMD_H */
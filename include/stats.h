@@ -0,0 +1,87 @@
+/**
+ * @file stats.h
+ * @brief per-stage timing and byte counters behind --stats
+ *
+ * the STATS_* macros are what the data path uses. they cost a branch when
+ * --stats is off and disappear entirely when the tree is built without
+ * ISENCHEF_STATS.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* --stats output styles, stored in config_t.stats */
+#define STATS_OFF 0
+#define STATS_TEXT 1
+#define STATS_JSON 2
+
+typedef enum {
+    STATS_READ,
+    STATS_DECODE,
+    STATS_ACTION,
+    STATS_ENCODE,
+    STATS_WRITE,
+    STATS_STAGES
+} stats_stage_t;
+
+/* clocks taken when a stage starts */
+typedef struct {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+} stats_mark_t;
+
+/**
+ * @brief turn collection on or off
+ * @param enabled non-zero to collect
+ */
+void stats_enable(int enabled);
+
+/**
+ * @brief read the clocks at the start of a stage
+ * @return start mark, zero when collection is off
+ */
+stats_mark_t stats_begin(void);
+
+/**
+ * @brief add the time since mark and the bytes handled to a stage
+ * @param stage stage the time belongs to
+ * @param mark value returned by stats_begin
+ * @param bytes_in bytes the stage consumed
+ * @param bytes_out bytes the stage produced
+ */
+void stats_end(stats_stage_t stage, stats_mark_t mark, uint64_t bytes_in, uint64_t bytes_out);
+
+/**
+ * @brief count one data buffer allocation
+ */
+void stats_count_alloc(void);
+
+/**
+ * @brief count one data buffer served again from the buffer pool
+ */
+void stats_count_reuse(void);
+
+/**
+ * @brief print the collected counters, peak rss included
+ * @param out output stream
+ * @param style STATS_TEXT or STATS_JSON
+ */
+void stats_print(FILE *out, int style);
+
+#ifdef ISENCHEF_STATS
+#define STATS_BEGIN(mark) stats_mark_t mark = stats_begin()
+#define STATS_END(stage, mark, bytes_in, bytes_out) \
+    stats_end((stage), (mark), (bytes_in), (bytes_out))
+#define STATS_ALLOC() stats_count_alloc()
+#define STATS_REUSE() stats_count_reuse()
+#else
+#define STATS_BEGIN(mark) ((void)0)
+#define STATS_END(stage, mark, bytes_in, bytes_out) ((void)0)
+#define STATS_ALLOC() ((void)0)
+#define STATS_REUSE() ((void)0)
+#endif
+
+#endif /* STATS_H */
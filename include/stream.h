@@ -0,0 +1,26 @@
+/**
+ * @file stream.h
+ * @brief chunked read -> decode -> action -> encode -> write pipeline
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "isenchef.h"
+#include "checksum.h"
+
+/**
+ * @brief process a configuration chunk by chunk
+ *
+ * memory use is bounded by config->chunk_size whatever the input size.
+ * hex pairs, base64 quads and xor/rc4 key positions that straddle a chunk
+ * boundary are carried over to the next chunk, so the output is the same
+ * as the one produced by read_file/write_file.
+ *
+ * @param config configuration (chunk_size must be non-zero)
+ * @param sums checksums fed chunk by chunk, may be NULL
+ * @return 0 on success, -1 on error
+ */
+int stream_execute(const config_t *config, checksum_set_t *sums);
+
+#endif /* STREAM_H */
@@ -0,0 +1,54 @@
+/**
+ * @file workers.h
+ * @brief process-wide worker pool for data-parallel loops
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stddef.h>
+
+/* below this many bytes a loop is not worth splitting */
+#define WORKERS_MIN_PARALLEL (1024 * 1024)
+
+/* slice size handed to one worker, a multiple of 3 (base64) and of 64 (cache lines) */
+#define WORKERS_SLICE_SIZE (3 * 64 * 1024)
+
+/**
+ * @brief task callback
+ * @param arg shared argument given to workers_run
+ * @param index task number, 0 to tasks - 1
+ */
+typedef void (*workers_fn)(void *arg, size_t index);
+
+/**
+ * @brief start the pool
+ * @param count total number of threads including the caller, 0 for one per cpu
+ * @return 0 on success, -1 on error
+ */
+int workers_start(int count);
+
+/**
+ * @brief stop and join the pool threads
+ */
+void workers_stop(void);
+
+/**
+ * @brief number of threads taking part in workers_run (1 without a pool)
+ * @return thread count
+ */
+int workers_count(void);
+
+/**
+ * @brief run fn(arg, i) for every i in [0, tasks) and wait for all of them
+ *
+ * the caller takes tasks too. without a pool, or when called from inside
+ * a task, everything runs on the calling thread.
+ *
+ * @param tasks number of tasks
+ * @param fn task callback
+ * @param arg shared argument
+ */
+void workers_run(size_t tasks, workers_fn fn, void *arg);
+
+#endif /* WORKERS_H */
@@ -0,0 +1,66 @@
+/**
+ * @file xor.h
+ * @brief repeating-key xor applied a vector at a time
+ */
+
+#ifndef XOR_H
+#define XOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* widest load the kernels make from the key pattern */
+#define XOR_MAX_WIDTH 32
+
+/*
+ * the key repeated until any window of XOR_MAX_WIDTH bytes starting at
+ * a key position can be loaded directly, whatever the key length.
+ */
+typedef struct {
+    uint8_t *pattern;  /* length + XOR_MAX_WIDTH bytes of repeated key */
+    size_t length;     /* key period in bytes */
+} xor_key_t;
+
+/**
+ * @brief build a key from raw bytes (may contain zero bytes)
+ * @param key key to initialize
+ * @param bytes key bytes
+ * @param length number of key bytes, must not be 0
+ * @return 0 on success, -1 on error
+ */
+int xor_key_init(xor_key_t *key, const uint8_t *bytes, size_t length);
+
+/**
+ * @brief build a key from a null-terminated string
+ * @param key key to initialize
+ * @param text key text, must not be empty
+ * @return 0 on success, -1 on error
+ */
+int xor_key_from_text(xor_key_t *key, const char *text);
+
+/**
+ * @brief build a key from hex digits, so binary keys can be given on the command line
+ * @param key key to initialize
+ * @param hex even number of hex digits, whitespace ignored
+ * @return 0 on success, -1 on error
+ */
+int xor_key_from_hex(xor_key_t *key, const char *hex);
+
+/**
+ * @brief xor src with the key while copying to dst
+ * @param key initialized key
+ * @param src source buffer
+ * @param dst destination buffer (may be src)
+ * @param size buffer size
+ * @param offset position of src[0] in the whole stream, selects the key byte
+ */
+void xor_apply(const xor_key_t *key, const uint8_t *src, uint8_t *dst, size_t size,
+               uint64_t offset);
+
+/**
+ * @brief free key resources
+ * @param key key to free
+ */
+void xor_key_free(xor_key_t *key);
+
+#endif /* XOR_H */
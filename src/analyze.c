@@ -0,0 +1,458 @@
+/**
+ * @file analyze.c
+ * @brief key recovery for caesar and xor ciphertexts (--analyze)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../include/analyze.h"
+#include "../include/simd.h"
+#include "../include/workers.h"
+#include "../include/stats.h"
+
+/* input counted per histogram task */
+#define ANALYZE_SLICE (4 * 1024 * 1024)
+
+/* likely key lengths whose keys are recovered, one histogram pass each */
+#define ANALYZE_LENGTHS 3
+
+/* natural log of the english letter frequencies, a to z */
+static const double letter_log[26] = {
+    -2.502, -4.201, -3.577, -3.148, -2.065, -3.818, -3.913, -2.798, -2.660,
+    -6.503, -4.868, -3.220, -3.731, -2.704, -2.591, -3.965, -6.960, -2.815,
+    -2.766, -2.398, -3.577, -4.627, -3.731, -6.503, -3.913, -7.210};
+
+/* log-likelihood of every byte in english text, for the xor scores */
+static double byte_log[256];
+
+__attribute__((constructor)) static void byte_log_build(void) {
+    for (int b = 0; b < 256; b++) {
+        if (b >= 'a' && b <= 'z') {
+            byte_log[b] = letter_log[b - 'a'] - 0.329;  /* 72% of the text */
+        } else if (b >= 'A' && b <= 'Z') {
+            byte_log[b] = letter_log[b - 'A'] - 3.689;  /* 2.5% */
+        } else if (b == ' ') {
+            byte_log[b] = -1.897;
+        } else if (b == '\n') {
+            byte_log[b] = -4.200;
+        } else if (b == ',' || b == '.') {
+            byte_log[b] = -4.605;
+        } else if ((b >= '0' && b <= '9') || b == '\'' || b == '"') {
+            byte_log[b] = -5.809;
+        } else if (b == '-' || b == '\t' || b == '\r') {
+            byte_log[b] = -6.908;
+        } else if (b > ' ' && b < 0x7f) {
+            byte_log[b] = -7.601;
+        } else if (b >= 0x80) {
+            byte_log[b] = -9.903;  /* utf-8 */
+        } else {
+            byte_log[b] = -13.816;
+        }
+    }
+}
+
+/* one histogram pass, counts[column * 256 + byte] with column the position modulo period */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t period;
+    _Atomic uint64_t *counts;
+    atomic_int failed;
+} histogram_job_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    double *distance;  /* per key length, bits differing per byte */
+} distance_job_t;
+
+typedef struct {
+    uint8_t key[ANALYZE_MAX_KEY];
+    size_t length;
+    double score;
+} xor_candidate_t;
+
+/*
+ * four tables so that runs of the same byte (spaces, zeros) do not wait
+ * on each other's increment, one 8-byte load per eight bytes.
+ */
+static void count_bytes(const uint8_t *data, size_t size, uint32_t tables[4][256]) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        tables[0][word & 0xff]++;
+        tables[1][(word >> 8) & 0xff]++;
+        tables[2][(word >> 16) & 0xff]++;
+        tables[3][(word >> 24) & 0xff]++;
+        tables[0][(word >> 32) & 0xff]++;
+        tables[1][(word >> 40) & 0xff]++;
+        tables[2][(word >> 48) & 0xff]++;
+        tables[3][word >> 56]++;
+    }
+    for (; i < size; i++) {
+        tables[0][data[i]]++;
+    }
+}
+
+/* consecutive bytes already land in different column tables, one row of period bytes per step */
+static void count_columns(const uint8_t *data, size_t size, size_t period, size_t column,
+                          uint32_t *tables) {
+    size_t i = 0;
+
+    for (; i < size && column != 0; i++) {
+        tables[column * 256 + data[i]]++;
+        if (++column == period) {
+            column = 0;
+        }
+    }
+    for (; i + period <= size; i += period) {
+        for (size_t c = 0; c < period; c++) {
+            tables[c * 256 + data[i + c]]++;
+        }
+    }
+    for (size_t c = 0; i < size; i++, c++) {
+        tables[c * 256 + data[i]]++;
+    }
+}
+
+static void histogram_slice(void *arg, size_t index) {
+    histogram_job_t *job = (histogram_job_t *)arg;
+    size_t start = index * ANALYZE_SLICE;
+    size_t size = (job->size - start < ANALYZE_SLICE) ? job->size - start : ANALYZE_SLICE;
+    size_t entries = job->period * 256;
+    uint32_t *tables = (uint32_t *)calloc(job->period == 1 ? 4 * 256 : entries, sizeof(uint32_t));
+
+    if (!tables) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    if (job->period == 1) {
+        count_bytes(job->data + start, size, (uint32_t(*)[256])tables);
+        for (size_t t = 1; t < 4; t++) {
+            for (size_t b = 0; b < 256; b++) {
+                tables[b] += tables[t * 256 + b];
+            }
+        }
+    } else {
+        count_columns(job->data + start, size, job->period, start % job->period, tables);
+    }
+    for (size_t e = 0; e < entries; e++) {
+        if (tables[e]) {
+            atomic_fetch_add_explicit(&job->counts[e], tables[e], memory_order_relaxed);
+        }
+    }
+    free(tables);
+}
+
+/* counts[column * 256 + byte] over the whole input, slices counted on the worker pool */
+static int histogram(const uint8_t *data, size_t size, size_t period, uint64_t *counts) {
+    histogram_job_t job;
+    size_t entries = period * 256;
+
+    job.data = data;
+    job.size = size;
+    job.period = period;
+    job.counts = (_Atomic uint64_t *)calloc(entries, sizeof(*job.counts));
+    if (!job.counts) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    atomic_init(&job.failed, 0);
+    workers_run((size + ANALYZE_SLICE - 1) / ANALYZE_SLICE, histogram_slice, &job);
+    for (size_t e = 0; e < entries; e++) {
+        counts[e] = atomic_load_explicit(&job.counts[e], memory_order_relaxed);
+    }
+    free(job.counts);
+    if (atomic_load(&job.failed)) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t hamming(const uint8_t *a, const uint8_t *b, size_t size) {
+    uint64_t bits = 0;
+    size_t i = 0;
+
+    switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+        case CPU_AVX2:
+            i = hamming_avx2(a, b, size, &bits);
+            break;
+        case CPU_SSSE3:
+            i = hamming_ssse3(a, b, size, &bits);
+            break;
+#endif
+        default:
+            break;
+    }
+    for (; i + 8 <= size; i += 8) {
+        uint64_t x;
+        uint64_t y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        bits += (uint64_t)__builtin_popcountll(x ^ y);
+    }
+    for (; i < size; i++) {
+        bits += (uint64_t)__builtin_popcount((unsigned int)(a[i] ^ b[i]));
+    }
+    return bits;
+}
+
+/* task index + 1 is the key length, every byte compared with the one length further */
+static void distance_task(void *arg, size_t index) {
+    distance_job_t *job = (distance_job_t *)arg;
+    size_t length = index + 1;
+    size_t pairs = job->size - length;
+
+    job->distance[length] =
+        (double)hamming(job->data, job->data + length, pairs) / (double)pairs;
+}
+
+/* mean log-likelihood per byte of the best key byte for one column histogram */
+static double best_key_byte(const uint64_t counts[256], uint8_t *key, double scores[256]) {
+    double best = 0;
+
+    for (int k = 0; k < 256; k++) {
+        double score = 0;
+        for (int c = 0; c < 256; c++) {
+            if (counts[c]) {
+                score += (double)counts[c] * byte_log[c ^ k];
+            }
+        }
+        if (scores) {
+            scores[k] = score;
+        }
+        if (k == 0 || score > best) {
+            best = score;
+            *key = (uint8_t)k;
+        }
+    }
+    return best;
+}
+
+/* shortest period of a key, "abab" is "ab" */
+static size_t key_period(const uint8_t *key, size_t length) {
+    for (size_t period = 1; period < length; period++) {
+        if (length % period == 0 && memcmp(key, key + period, length - period) == 0) {
+            return period;
+        }
+    }
+    return length;
+}
+
+static void print_key(FILE *out, const uint8_t *key, size_t length) {
+    int printable = 1;
+
+    fprintf(out, "--xor-key-hex=");
+    for (size_t i = 0; i < length; i++) {
+        fprintf(out, "%02x", key[i]);
+        printable &= key[i] >= ' ' && key[i] < 0x7f && key[i] != '"';
+    }
+    if (printable) {
+        fprintf(out, " \"%.*s\"", (int)length, (const char *)key);
+    }
+}
+
+static void report_caesar(FILE *out, const uint64_t counts[256]) {
+    uint64_t letters[26];
+    uint64_t total = 0;
+    double scores[26];
+    int order[26];
+
+    for (int l = 0; l < 26; l++) {
+        letters[l] = counts['a' + l] + counts['A' + l];
+        total += letters[l];
+    }
+    fprintf(out, "caesar shifts (log-likelihood per letter, higher is better):\n");
+    if (total == 0) {
+        fprintf(out, "  no letters in the input\n");
+        return;
+    }
+    /* text shifted by s has its letter c where the plain text had c - s */
+    for (int s = 0; s < 26; s++) {
+        double score = 0;
+        for (int c = 0; c < 26; c++) {
+            score += (double)letters[c] * letter_log[(c - s + 26) % 26];
+        }
+        scores[s] = score / (double)total;
+        order[s] = s;
+    }
+    for (int i = 1; i < 26; i++) {
+        int s = order[i];
+        int j = i;
+        for (; j > 0 && scores[order[j - 1]] < scores[s]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = s;
+    }
+    for (int i = 0; i < ANALYZE_TOP; i++) {
+        int s = order[i];
+        fprintf(out, "  %d. shift %-2d  undo with --caesar-shift=%-2d  %.3f\n", i + 1, s,
+                (26 - s) % 26, scores[s]);
+    }
+}
+
+static void report_single_byte(FILE *out, const uint64_t counts[256], size_t size) {
+    double scores[256];
+    uint8_t best;
+
+    best_key_byte(counts, &best, scores);
+    fprintf(out, "xor single-byte keys (log-likelihood per byte, higher is better):\n");
+    for (int i = 0; i < ANALYZE_TOP; i++) {
+        int top = 0;
+        for (int k = 1; k < 256; k++) {
+            if (scores[k] > scores[top]) {
+                top = k;
+            }
+        }
+        uint8_t key = (uint8_t)top;
+        fprintf(out, "  %d. ", i + 1);
+        print_key(out, &key, 1);
+        fprintf(out, "  %.3f\n", scores[top] / (double)size);
+        scores[top] = -1e300;
+    }
+}
+
+/* estimate the key length, then recover one key per likely length */
+static int report_repeating(FILE *out, const config_t *config, const uint8_t *data, size_t size) {
+    double distance[ANALYZE_MAX_KEY + 1];
+    size_t lengths[ANALYZE_MAX_KEY];
+    size_t length_count = 0;
+    xor_candidate_t candidates[ANALYZE_LENGTHS];
+    size_t candidate_count = 0;
+    size_t sample = (size < ANALYZE_SAMPLE) ? size : ANALYZE_SAMPLE;
+    size_t max_length = config->max_key_length;
+    distance_job_t job;
+
+    if (max_length > sample / 2) {
+        max_length = sample / 2;
+    }
+    fprintf(out, "xor key lengths (bits differing per byte, lower is better):\n");
+    if (max_length < 2) {
+        fprintf(out, "  input too short\n");
+        return 0;
+    }
+    job.data = data;
+    job.size = sample;
+    job.distance = distance;
+    workers_run(max_length, distance_task, &job);
+
+    /* length 1 is the single-byte case, a multiple of a kept length adds nothing */
+    for (size_t l = 2; l <= max_length; l++) {
+        lengths[length_count++] = l;
+    }
+    for (size_t i = 1; i < length_count; i++) {
+        size_t l = lengths[i];
+        size_t j = i;
+        for (; j > 0 && distance[lengths[j - 1]] > distance[l]; j--) {
+            lengths[j] = lengths[j - 1];
+        }
+        lengths[j] = l;
+    }
+    for (size_t i = 0; i < ANALYZE_TOP && i < length_count; i++) {
+        fprintf(out, "  %zu. %-3zu %.3f\n", i + 1, lengths[i], distance[lengths[i]]);
+    }
+
+    uint64_t *counts = (uint64_t *)malloc(ANALYZE_MAX_KEY * 256 * sizeof(uint64_t));
+    if (!counts) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < length_count && candidate_count < ANALYZE_LENGTHS; i++) {
+        size_t length = lengths[i];
+        int multiple = 0;
+        for (size_t c = 0; c < candidate_count; c++) {
+            multiple |= length % candidates[c].length == 0;
+        }
+        if (multiple) {
+            continue;
+        }
+        if (histogram(data, size, length, counts) < 0) {
+            free(counts);
+            return -1;
+        }
+        xor_candidate_t *candidate = &candidates[candidate_count];
+        candidate->score = 0;
+        for (size_t c = 0; c < length; c++) {
+            candidate->score += best_key_byte(counts + c * 256, &candidate->key[c], NULL);
+        }
+        candidate->score /= (double)size;
+        candidate->length = key_period(candidate->key, length);
+
+        int seen = 0;
+        for (size_t c = 0; c < candidate_count; c++) {
+            seen |= candidates[c].length == candidate->length &&
+                    memcmp(candidates[c].key, candidate->key, candidate->length) == 0;
+        }
+        if (!seen) {
+            candidate_count++;
+        }
+    }
+    free(counts);
+
+    for (size_t i = 1; i < candidate_count; i++) {
+        xor_candidate_t candidate = candidates[i];
+        size_t j = i;
+        for (; j > 0 && candidates[j - 1].score < candidate.score; j--) {
+            candidates[j] = candidates[j - 1];
+        }
+        candidates[j] = candidate;
+    }
+    fprintf(out, "xor repeating keys (log-likelihood per byte, higher is better):\n");
+    for (size_t i = 0; i < candidate_count; i++) {
+        fprintf(out, "  %zu. ", i + 1);
+        print_key(out, candidates[i].key, candidates[i].length);
+        fprintf(out, "  %.3f\n", candidates[i].score);
+    }
+    return 0;
+}
+
+int analyze_execute(const config_t *config, io_scratch_t *scratch) {
+    buffer_t buffer = {0};
+    uint64_t counts[256];
+    FILE *out = NULL;
+    int result = -1;
+
+    if (read_file_scratch(config->input_file, config->input_format, &buffer, scratch) < 0) {
+        fprintf(stderr, "failed to read input file\n");
+        return -1;
+    }
+    out = open_output(config->output_file);
+    if (!out) {
+        perror("opening output file");
+        return -1;
+    }
+
+    STATS_BEGIN(action_mark);
+    fprintf(out, "input: %s, %zu bytes\n", config->input_file, buffer.size);
+    if (buffer.size == 0) {
+        result = 0;
+        goto cleanup;
+    }
+    if (histogram(buffer.data, buffer.size, 1, counts) < 0) {
+        goto cleanup;
+    }
+    if (config->analyze & ANALYZE_CAESAR) {
+        report_caesar(out, counts);
+    }
+    if (config->analyze & ANALYZE_XOR) {
+        report_single_byte(out, counts, buffer.size);
+        if (report_repeating(out, config, buffer.data, buffer.size) < 0) {
+            goto cleanup;
+        }
+    }
+    result = 0;
+
+cleanup:
+    STATS_END(STATS_ACTION, action_mark, buffer.size, 0);
+    if (close_file(out) != 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    return result;
+}
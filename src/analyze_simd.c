@@ -0,0 +1,62 @@
+/**
+ * @file analyze_simd.c
+ * @brief ssse3/avx2 kernels counting the bits that differ between two byte runs
+ *
+ * the xor of both runs is split into nibbles whose bit counts come from a
+ * 16-entry pshufb table, and psadbw sums the per-byte counts into 64-bit
+ * lanes every block, so the counters never overflow.
+ */
+
+#include "../include/simd.h"
+
+#ifdef ISENCHEF_X86
+
+#include <immintrin.h>
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSSE3 size_t hamming_ssse3(const uint8_t *a, const uint8_t *b, size_t size, uint64_t *bits) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i counts = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                  _mm_loadu_si128((const __m128i *)(b + i)));
+        __m128i lo = _mm_shuffle_epi8(counts, _mm_and_si128(v, nibble));
+        __m128i hi = _mm_shuffle_epi8(counts, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        total = _mm_add_epi64(total, _mm_sad_epu8(_mm_add_epi8(lo, hi), _mm_setzero_si128()));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, total);
+    *bits += lanes[0] + lanes[1];
+    return i;
+}
+
+AVX2 size_t hamming_avx2(const uint8_t *a, const uint8_t *b, size_t size, uint64_t *bits) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                     _mm256_loadu_si256((const __m256i *)(b + i)));
+        __m256i lo = _mm256_shuffle_epi8(counts, _mm256_and_si256(v, nibble));
+        __m256i hi = _mm256_shuffle_epi8(counts,
+                                         _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        total = _mm256_add_epi64(total,
+                                 _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(total),
+                                 _mm256_extracti128_si256(total, 1));
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, half);
+    *bits += lanes[0] + lanes[1];
+    return i;
+}
+
+#endif /* ISENCHEF_X86 */
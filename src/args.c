@@ -7,6 +7,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../include/isenchef.h"
+#include "../include/stats.h"
+#include "../include/async_io.h"
+#include "../include/records.h"
+#include "../include/checksum.h"
+#include "../include/analyze.h"
 
 /* convert format string to enum */
 static int parse_format(const char *str) {
@@ -36,17 +41,228 @@ static int parse_action(const char *str) {
     return -1;
 }
 
+/* parse a byte count with optional k/m suffix, 0 on error */
+static size_t parse_size(const char *str) {
+    char *end;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (end == str) {
+        return 0;
+    }
+    if (*end == 'k' || *end == 'K') {
+        value *= 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        value *= 1024 * 1024;
+        end++;
+    }
+    if (*end != '\0') {
+        return 0;
+    }
+    return (size_t)value;
+}
+
+/*
+ * add an --out sink. a ":<format>" suffix naming a known format selects the
+ * format of that sink, anything else is part of the file name.
+ */
+static int add_output(config_t *config, char *arg) {
+    output_sink_t *outputs = (output_sink_t *)realloc(
+        config->outputs, (config->output_count + 1) * sizeof(output_sink_t));
+    if (!outputs) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    config->outputs = outputs;
+
+    output_sink_t *sink = &outputs[config->output_count++];
+    char *colon = strrchr(arg, ':');
+    int format = colon ? parse_format(colon + 1) : -1;
+    sink->file = arg;
+    sink->format = FORMAT_BYTES;
+    sink->format_given = format >= 0;
+    if (format >= 0) {
+        *colon = '\0';
+        sink->format = (format_t)format;
+    }
+    if (*sink->file == '\0') {
+        fprintf(stderr, "--out requires a filename\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* sinks without a format take --output-format (or the to_ step of the recipe) */
+static int resolve_outputs(config_t *config) {
+    for (size_t i = 0; i < config->output_count; i++) {
+        if (!config->outputs[i].format_given) {
+            config->outputs[i].format = config->output_format;
+        }
+        /* formats are written concurrently, two of them would race on one file */
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(config->outputs[i].file, config->outputs[j].file) == 0) {
+                fprintf(stderr, "--out %s is given twice\n", config->outputs[i].file);
+                return -1;
+            }
+        }
+    }
+    if (config->output_count > 0) {
+        config->output_format = config->outputs[0].format;
+    }
+    return 0;
+}
+
+/* actions that cannot run without a parameter */
+static int action_needs_param(action_t action) {
+    return action == ACTION_CAESAR || action == ACTION_RC4 || action == ACTION_XOR;
+}
+
+/*
+ * split a recipe "step[:param],step[:param],..." into config->steps.
+ * from_hex/from_base64 may open the recipe and to_hex/to_base64 may close
+ * it, they set the input and output formats.
+ */
+int parse_recipe(const char *recipe, config_t *config) {
+    size_t len = strlen(recipe);
+    size_t count = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (recipe[i] == ',') {
+            count++;
+        }
+    }
+    config->recipe_text = (char *)malloc(len + 1);
+    config->steps = (recipe_step_t *)calloc(count, sizeof(recipe_step_t));
+    if (!config->recipe_text || !config->steps) {
+        report_error("memory allocation failed\n");
+        return -1;
+    }
+    memcpy(config->recipe_text, recipe, len + 1);
+
+    char *token = config->recipe_text;
+    for (size_t i = 0; i < count; i++) {
+        char *next = strchr(token, ',');
+        if (next) {
+            *next++ = '\0';
+        }
+        char *param = strchr(token, ':');
+        if (param) {
+            *param++ = '\0';
+        }
+
+        if (strcmp(token, "from_hex") == 0 || strcmp(token, "from_base64") == 0) {
+            if (i != 0) {
+                report_error("recipe: %s must be the first step\n", token);
+                return -1;
+            }
+            config->input_format = (token[5] == 'h') ? FORMAT_HEX : FORMAT_BASE64;
+        } else if (strcmp(token, "xor_hex") == 0) {
+            if (!param || *param == '\0') {
+                report_error("recipe: xor_hex requires a parameter (xor_hex:<hex>)\n");
+                return -1;
+            }
+            config->steps[config->step_count].action = ACTION_XOR;
+            config->steps[config->step_count].param = param;
+            config->steps[config->step_count].param_hex = 1;
+            config->step_count++;
+        } else if (strcmp(token, "rc4_drop") == 0) {
+            /* rc4_drop:<n>:<key>, the key may itself contain ':' */
+            char *key = param ? strchr(param, ':') : NULL;
+            if (!key || key[1] == '\0') {
+                report_error("recipe: rc4_drop requires a count and a key "
+                         "(rc4_drop:<n>:<key>)\n");
+                return -1;
+            }
+            *key++ = '\0';
+            char *end;
+            unsigned long long drop = strtoull(param, &end, 10);
+            if (*param == '\0' || *end != '\0') {
+                report_error("recipe: invalid rc4 drop count: %s\n", param);
+                return -1;
+            }
+            config->steps[config->step_count].action = ACTION_RC4;
+            config->steps[config->step_count].param = key;
+            config->steps[config->step_count].drop = (size_t)drop;
+            config->step_count++;
+        } else if (strcmp(token, "to_hex") == 0 || strcmp(token, "to_base64") == 0) {
+            if (i != count - 1) {
+                report_error("recipe: %s must be the last step\n", token);
+                return -1;
+            }
+            config->output_format = (token[3] == 'h') ? FORMAT_HEX : FORMAT_BASE64;
+        } else {
+            int action = parse_action(token);
+            if (action < 0) {
+                report_error("recipe: invalid step: %s\n", token);
+                return -1;
+            }
+            if (action_needs_param((action_t)action) && (!param || *param == '\0')) {
+                report_error("recipe: %s requires a parameter (%s:<value>)\n", token, token);
+                return -1;
+            }
+            config->steps[config->step_count].action = (action_t)action;
+            config->steps[config->step_count].param = param;
+            config->step_count++;
+        }
+        token = next;
+    }
+    return 0;
+}
+
 /* print usage help */
 static void print_usage(const char *program_name) {
     fprintf(stderr, "usage: %s --in <file> --input-format <format> "
                     "[--action <action> [--<action>-param=<value>]] "
                     "--out <file> --output-format <format>\n\n", program_name);
     fprintf(stderr, "formats: bytes, hex, base64\n");
+    fprintf(stderr, "--out <file>:<format> sets the format of one output, repeat --out to write "
+                    "the result to several files in one pass\n");
     fprintf(stderr, "actions: caesar, rc4, uppercase, lowercase, xor\n");
     fprintf(stderr, "action parameters:\n");
     fprintf(stderr, "  --caesar-shift=<n>     shift value for caesar cipher\n");
     fprintf(stderr, "  --rc4-key=<key>        key for rc4 cipher (or --rc4key=)\n");
+    fprintf(stderr, "  --rc4-drop=<n>         discard the first n keystream bytes "
+                    "(rc4_drop:<n>:<key> in recipes)\n");
     fprintf(stderr, "  --xor-key=<key>        key for xor operation (or --xorkey=)\n");
+    fprintf(stderr, "  --xor-key-hex=<hex>    binary xor key given as hex digits "
+                    "(xor_hex:<hex> in recipes)\n");
+    fprintf(stderr, "  --recipe <steps>       comma-separated steps run in one pass, e.g.\n");
+    fprintf(stderr, "                         from_base64,xor:key,rc4:secret,uppercase,to_hex\n");
+    fprintf(stderr, "processing options:\n");
+    fprintf(stderr, "  --stream               process the input chunk by chunk (bounded memory)\n");
+    fprintf(stderr, "  --chunk-size=<n>       chunk size for --stream, accepts k/m suffix "
+                    "(default 1m)\n");
+    fprintf(stderr, "  --io=<backend>         --stream reads ahead and writes behind with "
+                    "auto, uring, threads or sync\n");
+    fprintf(stderr, "  --threads <n>          split large buffers across n threads "
+                    "(0 = one per cpu)\n");
+    fprintf(stderr, "  --mmap                 map files instead of copying them "
+                    "(bytes formats only)\n");
+    fprintf(stderr, "  --direct               write the output around the page cache "
+                    "(O_DIRECT)\n");
+    fprintf(stderr, "  --in-place             transform the input file itself, replaces --out\n");
+    fprintf(stderr, "  --records <mode>       transform every line, or every record with a 4-byte "
+                    "big-endian length, on its own\n");
+    fprintf(stderr, "  --checksum <a>[:<p>]   crc32c, xxh64 or sha256 of the data at a point: "
+                    "decoded, transformed\n");
+    fprintf(stderr, "                         or output (default), computed during the job\n");
+    fprintf(stderr, "  --checksum-file <f>    append the checksums to f instead of stdout\n");
+    fprintf(stderr, "analysis:\n");
+    fprintf(stderr, "  --analyze <cipher>     rank the likely caesar shifts or xor keys of the "
+                    "input (caesar, xor, all),\n");
+    fprintf(stderr, "                         report to --out or stdout\n");
+    fprintf(stderr, "  --max-key-length=<n>   longest repeating xor key tried (default %d)\n",
+            ANALYZE_DEFAULT_KEY);
+    fprintf(stderr, "  --stats[=json]         print per-stage time, bytes and memory to stderr\n");
+    fprintf(stderr, "batch mode (threads default to one per cpu):\n");
+    fprintf(stderr, "  --batch <manifest>     run every line of the manifest as a job "
+                    "(same options as here)\n");
+    fprintf(stderr, "  --batch-dir <dir>      run every file below dir as a job, "
+                    "--out names the output directory\n");
+    fprintf(stderr, "daemon mode:\n");
+    fprintf(stderr, "  --serve <socket>       answer requests on a unix socket "
+                    "(--threads connections at once)\n");
+    fprintf(stderr, "  %s client <socket> [options]   send one job to the daemon, "
+                    "stdin/stdout without --in\n", program_name);
     fprintf(stderr, "\nexamples:\n");
     fprintf(stderr, "  %s --in input.bin --input-format hex --out output.bin --output-format base64\n",
             program_name);
@@ -55,10 +271,16 @@ static void print_usage(const char *program_name) {
 }
 
 int parse_arguments(int argc, char *argv[], config_t *config) {
+    const char *recipe = NULL;
+    int threads_given = 0;
+
     memset(config, 0, sizeof(config_t));
     config->input_format = FORMAT_BYTES;
     config->output_format = FORMAT_BYTES;
     config->action = ACTION_NONE;
+    config->chunk_size = MAX_BUFFER_SIZE;
+    config->threads = 1;
+    config->max_key_length = ANALYZE_DEFAULT_KEY;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--in") == 0 || strcmp(argv[i], "-i") == 0) {
@@ -72,7 +294,10 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
                 fprintf(stderr, "--out requires a filename\n");
                 return -1;
             }
-            config->output_file = argv[++i];
+            if (add_output(config, argv[++i]) < 0) {
+                return -1;
+            }
+            config->output_file = config->outputs[0].file;
         } else if (strcmp(argv[i], "--input-format") == 0) {
             if (i + 1 >= argc) {
                 fprintf(stderr, "--input-format requires a format\n");
@@ -106,12 +331,154 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
                 return -1;
             }
             config->action = (action_t)action;
+        } else if (strcmp(argv[i], "--recipe") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--recipe requires a list of steps\n");
+                return -1;
+            }
+            recipe = argv[++i];
         } else if (strncmp(argv[i], "--caesar-shift=", 15) == 0) {
             config->action_param = argv[i] + 15;
         } else if (strncmp(argv[i], "--rc4-key=", 10) == 0 || strncmp(argv[i], "--rc4key=", 9) == 0) {
             config->action_param = (strncmp(argv[i], "--rc4-key=", 10) == 0) ? argv[i] + 10 : argv[i] + 9;
         } else if (strncmp(argv[i], "--xor-key=", 10) == 0 || strncmp(argv[i], "--xorkey=", 9) == 0) {
             config->action_param = (strncmp(argv[i], "--xor-key=", 10) == 0) ? argv[i] + 10 : argv[i] + 9;
+            config->action_param_hex = 0;
+        } else if (strncmp(argv[i], "--rc4-drop=", 11) == 0) {
+            char *end;
+            config->rc4_drop = (size_t)strtoull(argv[i] + 11, &end, 10);
+            if (argv[i][11] == '\0' || *end != '\0') {
+                fprintf(stderr, "invalid rc4 drop count: %s\n", argv[i] + 11);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--xor-key-hex=", 14) == 0) {
+            config->action_param = argv[i] + 14;
+            config->action_param_hex = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            config->streaming = 1;
+        } else if (strncmp(argv[i], "--chunk-size=", 13) == 0) {
+            config->chunk_size = parse_size(argv[i] + 13);
+            if (config->chunk_size == 0) {
+                fprintf(stderr, "invalid chunk size: %s\n", argv[i] + 13);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            char *end;
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--threads requires a thread count\n");
+                return -1;
+            }
+            long threads = strtol(argv[++i], &end, 10);
+            if (*argv[i] == '\0' || *end != '\0' || threads < 0 || threads > 1024) {
+                fprintf(stderr, "invalid thread count: %s\n", argv[i]);
+                return -1;
+            }
+            config->threads = (int)threads;
+            threads_given = 1;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--batch requires a manifest file\n");
+                return -1;
+            }
+            config->batch_file = argv[++i];
+        } else if (strcmp(argv[i], "--batch-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--batch-dir requires a directory\n");
+                return -1;
+            }
+            config->batch_dir = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--serve requires a socket path\n");
+                return -1;
+            }
+            config->serve_socket = argv[++i];
+        } else if (strncmp(argv[i], "--io=", 5) == 0) {
+            const char *name = argv[i] + 5;
+            if (strcmp(name, "auto") == 0) {
+                config->io_backend = IO_AUTO;
+            } else if (strcmp(name, "uring") == 0) {
+                config->io_backend = IO_URING;
+            } else if (strcmp(name, "threads") == 0) {
+                config->io_backend = IO_THREADS;
+            } else if (strcmp(name, "sync") == 0) {
+                config->io_backend = IO_SYNC;
+            } else {
+                fprintf(stderr, "invalid io backend: %s (auto, uring, threads, sync)\n", name);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--records") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--records requires a mode (lines, length)\n");
+                return -1;
+            }
+            const char *mode = argv[++i];
+            if (strcmp(mode, "lines") == 0) {
+                config->records = RECORDS_LINES;
+            } else if (strcmp(mode, "length") == 0) {
+                config->records = RECORDS_LENGTH;
+            } else {
+                fprintf(stderr, "invalid records mode: %s (lines, length)\n", mode);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--analyze") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--analyze requires a cipher (caesar, xor, all)\n");
+                return -1;
+            }
+            const char *cipher = argv[++i];
+            if (strcmp(cipher, "caesar") == 0) {
+                config->analyze = ANALYZE_CAESAR;
+            } else if (strcmp(cipher, "xor") == 0) {
+                config->analyze = ANALYZE_XOR;
+            } else if (strcmp(cipher, "all") == 0) {
+                config->analyze = ANALYZE_ALL;
+            } else {
+                fprintf(stderr, "invalid cipher to analyze: %s (caesar, xor, all)\n", cipher);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--max-key-length=", 17) == 0) {
+            char *end;
+            long length = strtol(argv[i] + 17, &end, 10);
+            if (argv[i][17] == '\0' || *end != '\0' || length < 2 || length > ANALYZE_MAX_KEY) {
+                fprintf(stderr, "invalid key length: %s (2 to %d)\n", argv[i] + 17,
+                        ANALYZE_MAX_KEY);
+                return -1;
+            }
+            config->max_key_length = (size_t)length;
+        } else if (strcmp(argv[i], "--checksum") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--checksum requires an algorithm\n");
+                return -1;
+            }
+            checksum_spec_t *checksums = (checksum_spec_t *)realloc(
+                config->checksums, (config->checksum_count + 1) * sizeof(checksum_spec_t));
+            if (!checksums) {
+                fprintf(stderr, "memory allocation failed\n");
+                return -1;
+            }
+            config->checksums = checksums;
+            if (checksum_parse(argv[++i], &checksums[config->checksum_count]) < 0) {
+                return -1;
+            }
+            config->checksum_count++;
+        } else if (strcmp(argv[i], "--checksum-file") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--checksum-file requires a filename\n");
+                return -1;
+            }
+            config->checksum_file = argv[++i];
+        } else if (strcmp(argv[i], "--direct") == 0) {
+            config->direct = 1;
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            config->mapped = 1;
+        } else if (strcmp(argv[i], "--in-place") == 0) {
+            config->in_place = 1;
+            config->mapped = 1;
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+            config->stats = STATS_TEXT;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            config->stats = STATS_JSON;
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             print_usage(argv[0]);
             return -2;  /* for help */
@@ -121,27 +488,193 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
             return -1;
         }
     }
-    if (!config->input_file) {
+    int batch = config->batch_file || config->batch_dir;
+    if (config->batch_file && config->batch_dir) {
+        fprintf(stderr, "--batch and --batch-dir cannot be used together\n");
+        return -1;
+    }
+    if (batch && config->input_file) {
+        fprintf(stderr, "--in cannot be used in batch mode\n");
+        return -1;
+    }
+    if (config->batch_dir && config->output_file && is_stdio_path(config->output_file)) {
+        fprintf(stderr, "--batch-dir needs an output directory, not stdout\n");
+        return -1;
+    }
+    if (config->batch_file && config->output_file) {
+        fprintf(stderr, "--batch takes the output files from the manifest\n");
+        return -1;
+    }
+    if (config->output_count > 1 &&
+        (config->batch_dir || config->streaming || config->mapped || config->serve_socket)) {
+        fprintf(stderr, "several --out need a whole-file job, not --batch-dir, --stream, "
+                        "--mmap or --serve\n");
+        return -1;
+    }
+#ifndef ISENCHEF_STATS
+    if (config->stats != STATS_OFF) {
+        fprintf(stderr, "--stats is not available, rebuild with -DISENCHEF_STATS=ON\n");
+        return -1;
+    }
+#endif
+    if (config->records != RECORDS_NONE &&
+        (config->streaming || config->mapped || config->direct || config->output_count > 1)) {
+        fprintf(stderr, "--records reads and writes in its own batches, without --stream, "
+                        "--mmap, --in-place, --direct or several --out\n");
+        return -1;
+    }
+    if (config->checksum_count > 0 && (config->records != RECORDS_NONE || config->serve_socket)) {
+        fprintf(stderr, "--checksum applies to whole files, not --records, --serve or server "
+                        "requests\n");
+        return -1;
+    }
+    if (config->checksum_count > 0 && !config->checksum_file && config->output_file &&
+        is_stdio_path(config->output_file)) {
+        fprintf(stderr, "--checksum with --out - needs --checksum-file\n");
+        return -1;
+    }
+    if (config->analyze != ANALYZE_NONE) {
+        if (batch || config->serve_socket || config->streaming || config->mapped ||
+            config->records != RECORDS_NONE || config->checksum_count > 0 ||
+            config->output_count > 1 || config->action != ACTION_NONE || recipe) {
+            fprintf(stderr, "--analyze reads one whole input, without actions, --batch, "
+                            "--serve, --stream, --mmap, --records, --checksum or several --out\n");
+            return -1;
+        }
+        if (!config->output_file) {
+            config->output_file = (char *)"-";
+        }
+    }
+    if ((batch || config->records != RECORDS_NONE || config->analyze != ANALYZE_NONE) &&
+        !threads_given) {
+        config->threads = 0;
+    }
+    if (config->serve_socket) {
+        if (batch || config->input_file || config->output_file) {
+            fprintf(stderr, "--serve takes its jobs from the clients\n");
+            return -1;
+        }
+        if (!threads_given) {
+            config->threads = 0;
+        }
+        return 0;
+    }
+    if (!config->input_file && !batch) {
         fprintf(stderr, "--in is required\n");
         print_usage(argv[0]);
         return -1;
     }
-    if (!config->output_file) {
+    if (config->in_place) {
+        if (config->batch_file) {
+            fprintf(stderr, "--in-place goes on the manifest lines, not with --batch\n");
+            return -1;
+        }
+        if (config->input_file && is_stdio_path(config->input_file)) {
+            fprintf(stderr, "--in-place needs a file, not stdin\n");
+            return -1;
+        }
+        if (config->output_file) {
+            fprintf(stderr, "--in-place and --out cannot be used together\n");
+            return -1;
+        }
+        /* --batch-dir --in-place leaves it unset, every job writes its own input */
+        config->output_file = config->input_file;
+    }
+    if (config->streaming && config->mapped) {
+        fprintf(stderr, "--stream and --mmap cannot be used together\n");
+        return -1;
+    }
+    if (config->direct && (config->streaming || config->mapped)) {
+        fprintf(stderr, "--direct applies to whole-file output, not --stream or --mmap\n");
+        return -1;
+    }
+    if (!config->output_file && !config->batch_file && !config->in_place) {
         fprintf(stderr, "--out is required\n");
         print_usage(argv[0]);
         return -1;
     }
-    if (config->action != ACTION_NONE && 
-        (config->action == ACTION_CAESAR || config->action == ACTION_RC4 || 
-         config->action == ACTION_XOR) && !config->action_param) {
+    if (recipe) {
+        if (config->action != ACTION_NONE) {
+            fprintf(stderr, "--recipe and --action cannot be used together\n");
+            return -1;
+        }
+        if (parse_recipe(recipe, config) < 0) {
+            return -1;
+        }
+        return resolve_outputs(config);
+    }
+    if (config->action != ACTION_NONE && action_needs_param(config->action) &&
+        !config->action_param) {
         fprintf(stderr, "action requires a parameter\n");
         return -1;
     }
-    return 0;
+    if (config->action != ACTION_NONE) {
+        /* a single --action is a one-step recipe */
+        config->steps = (recipe_step_t *)malloc(sizeof(recipe_step_t));
+        if (!config->steps) {
+            fprintf(stderr, "memory allocation failed\n");
+            return -1;
+        }
+        config->steps[0].action = config->action;
+        config->steps[0].param = config->action_param;
+        config->steps[0].param_hex = config->action_param_hex;
+        config->steps[0].drop = config->rc4_drop;
+        config->step_count = 1;
+    }
+    return resolve_outputs(config);
+}
+
+char **split_arguments(char *line, int *argc) {
+    char **argv = (char **)malloc((strlen(line) / 2 + 3) * sizeof(char *));
+    char *p = line;
+
+    if (!argv) {
+        fprintf(stderr, "memory allocation failed\n");
+        return NULL;
+    }
+    *argc = 0;
+    argv[(*argc)++] = (char *)"isenchef";
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        char *out = p;
+        char quote = 0;
+        argv[(*argc)++] = p;
+        while (*p && (quote || (*p != ' ' && *p != '\t' && *p != '\r'))) {
+            if (!quote && (*p == '"' || *p == '\'')) {
+                quote = *p++;
+            } else if (quote && *p == quote) {
+                quote = 0;
+                p++;
+            } else {
+                *out++ = *p++;
+            }
+        }
+        if (*p) {
+            p++;
+        }
+        *out = '\0';
+    }
+    argv[*argc] = NULL;
+    return argv;
 }
 
 void free_config(config_t *config) {
-    (void)config;  /* rien a free ici ;) */
+    free(config->steps);
+    free(config->recipe_text);
+    free(config->outputs);
+    free(config->checksums);
+    config->steps = NULL;
+    config->recipe_text = NULL;
+    config->outputs = NULL;
+    config->checksums = NULL;
+    config->checksum_count = 0;
+    config->step_count = 0;
+    config->output_count = 0;
 }
 
 
@@ -0,0 +1,739 @@
+/**
+ * @file async_io.c
+ * @brief read-ahead and write-behind rings of buffers for the streaming path
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/async_io.h"
+#include "../include/buffer_pool.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define ASYNC_IO_URING 1
+#endif
+#endif
+#endif
+
+/* largest transfer of one request, what is left is requested again */
+#define ASYNC_IO_MAX_REQUEST (1u << 30)
+
+/* one buffer of a ring */
+typedef struct {
+    uint8_t *data;
+    size_t size;    /* bytes read into it, or to write from it */
+    size_t done;    /* bytes transferred so far */
+    off_t offset;   /* file offset of data[0], io_uring only */
+    int busy;       /* a request on it is in flight, io_uring only */
+} io_slot_t;
+
+#ifdef ASYNC_IO_URING
+
+/* an io_uring instance driven with raw system calls, no liburing */
+typedef struct {
+    int fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    int fixed;      /* the slots are registered buffers */
+} uring_t;
+
+typedef void (*uring_complete_fn)(void *owner, unsigned slot, int res);
+
+static int uring_setup(uring_t *ring, io_slot_t *slots, size_t slot_size) {
+    struct io_uring_params params;
+    struct iovec iov[ASYNC_IO_DEPTH];
+    int single;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, ASYNC_IO_DEPTH, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+    /* plain read/write requests at an offset appeared with this feature (5.6) */
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(ring->fd);
+        return -1;
+    }
+
+    single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (single && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    ring->cq_ring = ring->sq_ring;
+    if (!single) {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (!single) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+    ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+
+    /* pinned once instead of on every request, skipped when RLIMIT_MEMLOCK says no */
+    for (int i = 0; i < ASYNC_IO_DEPTH; i++) {
+        iov[i].iov_base = slots[i].data;
+        iov[i].iov_len = slot_size;
+    }
+    ring->fixed = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov,
+                          ASYNC_IO_DEPTH) == 0;
+    return 0;
+}
+
+static void uring_free(uring_t *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+/* queue and submit a request for what is left of a slot */
+static int uring_push(uring_t *ring, int write, int fd, io_slot_t *slot, unsigned number) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    size_t left = slot->size - slot->done;
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (ring->fixed) {
+        sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = (uint16_t)number;
+    } else {
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = fd;
+    sqe->off = (uint64_t)(slot->offset + (off_t)slot->done);
+    sqe->addr = (uint64_t)(uintptr_t)(slot->data + slot->done);
+    sqe->len = (uint32_t)((left < ASYNC_IO_MAX_REQUEST) ? left : ASYNC_IO_MAX_REQUEST);
+    sqe->user_data = number;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    slot->busy = 1;
+
+    while (syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            slot->busy = 0;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* wait for at least one completion and hand all of them to complete */
+static int uring_wait(uring_t *ring, uring_complete_fn complete, void *owner) {
+    while (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        unsigned number = (unsigned)cqe->user_data;
+        int res = cqe->res;
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        complete(owner, number, res);
+    }
+    return 0;
+}
+
+/* io_uring needs offsets, only regular files have them */
+static int uring_usable(int fd, int backend, int write) {
+    struct stat st;
+
+    if (backend == IO_THREADS || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+    /* appends in flight together could land in any order */
+    return !write || !(fcntl(fd, F_GETFL) & O_APPEND);
+}
+
+#endif /* ASYNC_IO_URING */
+
+/* one pooled block cut into ASYNC_IO_DEPTH buffers that each start on a page */
+static uint8_t *slots_alloc(io_slot_t *slots, size_t size, size_t *slot_size,
+                            size_t *capacity) {
+    const size_t page = 4096;
+    uint8_t *memory;
+
+    *slot_size = (size + page - 1) / page * page;
+    memory = (uint8_t *)pool_alloc(*slot_size * ASYNC_IO_DEPTH, capacity);
+    if (!memory) {
+        return NULL;
+    }
+    for (int i = 0; i < ASYNC_IO_DEPTH; i++) {
+        memset(&slots[i], 0, sizeof(slots[i]));
+        slots[i].data = (uint8_t *)memory + (size_t)i * *slot_size;
+    }
+    return memory;
+}
+
+struct async_reader {
+    int fd;
+    size_t chunk;
+    uint8_t *memory;
+    size_t capacity;    /* of memory, from the pool */
+    io_slot_t slots[ASYNC_IO_DEPTH];
+    uint64_t filled;    /* chunks read, the thread's counter */
+    uint64_t taken;     /* chunks handed to the caller */
+    uint64_t released;  /* chunks the caller gave back */
+    int error;          /* errno of the read that failed */
+    int uring;
+#ifdef ASYNC_IO_URING
+    uring_t ring;
+    uint64_t issued;    /* chunks given to a slot */
+    uint64_t total;     /* chunks in the file, known once one comes back short */
+    off_t start;
+#endif
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int stopping;
+};
+
+/* thread backend: blocking reads of whole chunks into the free slots */
+static void *reader_main(void *arg) {
+    async_reader_t *reader = (async_reader_t *)arg;
+    int last = 0;
+
+    pthread_mutex_lock(&reader->lock);
+    while (!last) {
+        while (!reader->stopping && reader->filled - reader->released == ASYNC_IO_DEPTH) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        if (reader->stopping) {
+            break;
+        }
+        /* the caller never looks at this slot until filled moves past it */
+        io_slot_t *slot = &reader->slots[reader->filled % ASYNC_IO_DEPTH];
+        pthread_mutex_unlock(&reader->lock);
+
+        int error = 0;
+        slot->size = 0;
+        while (slot->size < reader->chunk) {
+            ssize_t n = read(reader->fd, slot->data + slot->size, reader->chunk - slot->size);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                error = errno;
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+            slot->size += (size_t)n;
+        }
+        last = error || slot->size < reader->chunk;
+
+        pthread_mutex_lock(&reader->lock);
+        if (error) {
+            reader->error = error;
+        }
+        reader->filled++;
+        pthread_cond_broadcast(&reader->changed);
+    }
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+#ifdef ASYNC_IO_URING
+
+static void reader_complete(void *owner, unsigned number, int res) {
+    async_reader_t *reader = (async_reader_t *)owner;
+    io_slot_t *slot = &reader->slots[number];
+
+    slot->busy = 0;
+    if (res == -EINTR || res == -EAGAIN) {
+        res = 0;
+    } else if (res < 0) {
+        reader->error = -res;
+        return;
+    } else if (res == 0) {
+        /* end of the file, chunks after this one are not handed out */
+        uint64_t chunks = (uint64_t)(slot->offset - reader->start) / reader->chunk + 1;
+        slot->size = slot->done;
+        if (chunks < reader->total) {
+            reader->total = chunks;
+        }
+        return;
+    }
+    slot->done += (size_t)res;
+    if (slot->done < slot->size && uring_push(&reader->ring, 0, reader->fd, slot, number) < 0) {
+        reader->error = errno;
+    }
+}
+
+/*
+ * start reading the next chunk of the file into the slot it maps to. the
+ * size fstat reports is not trusted (procfs says 0, a log may be growing),
+ * chunks are read until one comes back short like the thread backend does.
+ */
+static void reader_issue(async_reader_t *reader) {
+    unsigned number = (unsigned)(reader->issued % ASYNC_IO_DEPTH);
+    io_slot_t *slot = &reader->slots[number];
+
+    slot->offset = reader->start + (off_t)(reader->issued * reader->chunk);
+    slot->done = 0;
+    slot->size = reader->chunk;
+    reader->issued++;
+    if (uring_push(&reader->ring, 0, reader->fd, slot, number) < 0) {
+        reader->error = errno;
+    }
+}
+
+static int reader_start_uring(async_reader_t *reader, size_t slot_size) {
+    if ((reader->start = lseek(reader->fd, 0, SEEK_CUR)) < 0 ||
+        uring_setup(&reader->ring, reader->slots, slot_size) < 0) {
+        return -1;
+    }
+    reader->total = UINT64_MAX;
+    while (reader->issued < reader->total && reader->issued < ASYNC_IO_DEPTH) {
+        reader_issue(reader);
+    }
+    reader->uring = 1;
+    return 0;
+}
+
+#endif /* ASYNC_IO_URING */
+
+async_reader_t *async_reader_open(int fd, size_t chunk, int backend) {
+    async_reader_t *reader;
+    size_t slot_size;
+
+    if (backend == IO_SYNC || chunk == 0) {
+        return NULL;
+    }
+    reader = (async_reader_t *)calloc(1, sizeof(async_reader_t));
+    if (!reader) {
+        fprintf(stderr, "memory allocation failed\n");
+        return NULL;
+    }
+    reader->fd = fd;
+    reader->chunk = chunk;
+    reader->memory = slots_alloc(reader->slots, chunk, &slot_size, &reader->capacity);
+    if (!reader->memory) {
+        free(reader);
+        return NULL;
+    }
+#ifdef ASYNC_IO_URING
+    if (uring_usable(fd, backend, 0) && reader_start_uring(reader, slot_size) == 0) {
+        return reader;
+    }
+#endif
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+    if (pthread_create(&reader->thread, NULL, reader_main, reader) != 0) {
+        fprintf(stderr, "failed to start reader thread\n");
+        pthread_cond_destroy(&reader->changed);
+        pthread_mutex_destroy(&reader->lock);
+        pool_free(reader->memory, reader->capacity);
+        free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+int async_reader_next(async_reader_t *reader, uint8_t **data, size_t *size) {
+    io_slot_t *slot = &reader->slots[reader->taken % ASYNC_IO_DEPTH];
+    int error;
+
+#ifdef ASYNC_IO_URING
+    if (reader->uring) {
+        if (reader->taken > reader->released) {
+            reader->released++;
+            if (reader->issued < reader->total) {
+                reader_issue(reader);
+            }
+        }
+        while (slot->busy && !reader->error) {
+            if (uring_wait(&reader->ring, reader_complete, reader) < 0) {
+                reader->error = errno;
+            }
+        }
+        error = reader->error;
+        if (!error) {
+            reader->taken++;
+            *data = slot->data;
+            *size = slot->size;
+            return 0;
+        }
+        fprintf(stderr, "reading input file: %s\n", strerror(error));
+        return -1;
+    }
+#endif
+    pthread_mutex_lock(&reader->lock);
+    if (reader->taken > reader->released) {
+        reader->released++;
+        pthread_cond_broadcast(&reader->changed);
+    }
+    while (reader->filled == reader->taken) {
+        pthread_cond_wait(&reader->changed, &reader->lock);
+    }
+    error = reader->error;
+    reader->taken++;
+    pthread_mutex_unlock(&reader->lock);
+    if (error) {
+        fprintf(stderr, "reading input file: %s\n", strerror(error));
+        return -1;
+    }
+    *data = slot->data;
+    *size = slot->size;
+    return 0;
+}
+
+void async_reader_close(async_reader_t *reader) {
+    if (!reader) {
+        return;
+    }
+#ifdef ASYNC_IO_URING
+    if (reader->uring) {
+        /* the kernel still writes into the slots of reads in flight */
+        for (int i = 0; i < ASYNC_IO_DEPTH; i++) {
+            while (reader->slots[i].busy) {
+                if (uring_wait(&reader->ring, reader_complete, reader) < 0) {
+                    break;
+                }
+            }
+        }
+        uring_free(&reader->ring);
+        pool_free(reader->memory, reader->capacity);
+        free(reader);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&reader->lock);
+    reader->stopping = 1;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->thread, NULL);
+
+    pthread_cond_destroy(&reader->changed);
+    pthread_mutex_destroy(&reader->lock);
+    pool_free(reader->memory, reader->capacity);
+    free(reader);
+}
+
+struct async_writer {
+    int fd;
+    uint8_t *memory;
+    size_t capacity;    /* of memory, from the pool */
+    io_slot_t slots[ASYNC_IO_DEPTH];
+    uint64_t queued;    /* buffers submitted by the caller */
+    uint64_t written;   /* buffers written, the thread's counter */
+    int error;          /* errno of the write that failed */
+    int uring;
+#ifdef ASYNC_IO_URING
+    uring_t ring;
+    off_t offset;       /* where the next buffer goes */
+#endif
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int stopping;
+};
+
+/* write a whole buffer with blocking writes, returns 0 or an errno */
+static int write_all(int fd, const uint8_t *data, size_t size) {
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t n = write(fd, data + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+/* thread backend: writes the queued buffers in order */
+static void *writer_main(void *arg) {
+    async_writer_t *writer = (async_writer_t *)arg;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (!writer->stopping && writer->written == writer->queued) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (writer->written == writer->queued) {
+            break;
+        }
+        io_slot_t *slot = &writer->slots[writer->written % ASYNC_IO_DEPTH];
+        int error = writer->error;
+        pthread_mutex_unlock(&writer->lock);
+
+        /* after a failure the rest is dropped, the caller learns it on its next call */
+        if (!error) {
+            error = write_all(writer->fd, slot->data, slot->size);
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        if (error) {
+            writer->error = error;
+        }
+        writer->written++;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+#ifdef ASYNC_IO_URING
+
+static void writer_complete(void *owner, unsigned number, int res) {
+    async_writer_t *writer = (async_writer_t *)owner;
+    io_slot_t *slot = &writer->slots[number];
+
+    slot->busy = 0;
+    if (res == -EINTR || res == -EAGAIN) {
+        res = 0;
+    } else if (res < 0) {
+        writer->error = -res;
+        return;
+    } else if (res == 0) {
+        writer->error = EIO;
+        return;
+    }
+    slot->done += (size_t)res;
+    if (slot->done < slot->size && uring_push(&writer->ring, 1, writer->fd, slot, number) < 0) {
+        writer->error = errno;
+    }
+}
+
+#endif /* ASYNC_IO_URING */
+
+async_writer_t *async_writer_open(int fd, size_t buffer_size, int backend) {
+    async_writer_t *writer;
+    size_t slot_size;
+
+    if (backend == IO_SYNC || buffer_size == 0) {
+        return NULL;
+    }
+    writer = (async_writer_t *)calloc(1, sizeof(async_writer_t));
+    if (!writer) {
+        fprintf(stderr, "memory allocation failed\n");
+        return NULL;
+    }
+    writer->fd = fd;
+    writer->memory = slots_alloc(writer->slots, buffer_size, &slot_size, &writer->capacity);
+    if (!writer->memory) {
+        free(writer);
+        return NULL;
+    }
+#ifdef ASYNC_IO_URING
+    if (uring_usable(fd, backend, 1) && (writer->offset = lseek(fd, 0, SEEK_CUR)) >= 0 &&
+        uring_setup(&writer->ring, writer->slots, slot_size) == 0) {
+        writer->uring = 1;
+        return writer;
+    }
+#endif
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        fprintf(stderr, "failed to start writer thread\n");
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+        pool_free(writer->memory, writer->capacity);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+uint8_t *async_writer_buffer(async_writer_t *writer) {
+    io_slot_t *slot = &writer->slots[writer->queued % ASYNC_IO_DEPTH];
+    int error;
+
+#ifdef ASYNC_IO_URING
+    if (writer->uring) {
+        while (slot->busy && !writer->error) {
+            if (uring_wait(&writer->ring, writer_complete, writer) < 0) {
+                writer->error = errno;
+            }
+        }
+        return writer->error ? NULL : slot->data;
+    }
+#endif
+    pthread_mutex_lock(&writer->lock);
+    while (writer->queued - writer->written == ASYNC_IO_DEPTH) {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+    return error ? NULL : slot->data;
+}
+
+int async_writer_submit(async_writer_t *writer, size_t size) {
+    unsigned number = (unsigned)(writer->queued % ASYNC_IO_DEPTH);
+    io_slot_t *slot = &writer->slots[number];
+    int error;
+
+    slot->size = size;
+    slot->done = 0;
+#ifdef ASYNC_IO_URING
+    if (writer->uring) {
+        slot->offset = writer->offset;
+        writer->offset += (off_t)size;
+        writer->queued++;
+        if (size > 0 && !writer->error &&
+            uring_push(&writer->ring, 1, writer->fd, slot, number) < 0) {
+            writer->error = errno;
+        }
+        return writer->error ? -1 : 0;
+    }
+#endif
+    pthread_mutex_lock(&writer->lock);
+    writer->queued++;
+    error = writer->error;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    return error ? -1 : 0;
+}
+
+int async_writer_close(async_writer_t *writer) {
+    int error;
+
+    if (!writer) {
+        return 0;
+    }
+#ifdef ASYNC_IO_URING
+    if (writer->uring) {
+        for (int i = 0; i < ASYNC_IO_DEPTH; i++) {
+            while (writer->slots[i].busy) {
+                if (uring_wait(&writer->ring, writer_complete, writer) < 0) {
+                    writer->error = errno;
+                    break;
+                }
+            }
+        }
+        /* requests at an offset leave the file position alone, move it past the data */
+        lseek(writer->fd, writer->offset, SEEK_SET);
+        uring_free(&writer->ring);
+    } else
+#endif
+    {
+        pthread_mutex_lock(&writer->lock);
+        writer->stopping = 1;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+        pthread_join(writer->thread, NULL);
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+    }
+    error = writer->error;
+    pool_free(writer->memory, writer->capacity);
+    free(writer);
+    if (error) {
+        fprintf(stderr, "writing output file: %s\n", strerror(error));
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+/* no overlapped i/o here, the streaming path keeps its blocking stdio calls */
+
+async_reader_t *async_reader_open(int fd, size_t chunk, int backend) {
+    (void)fd;
+    (void)chunk;
+    (void)backend;
+    return NULL;
+}
+
+int async_reader_next(async_reader_t *reader, uint8_t **data, size_t *size) {
+    (void)reader;
+    (void)data;
+    (void)size;
+    return -1;
+}
+
+void async_reader_close(async_reader_t *reader) {
+    (void)reader;
+}
+
+async_writer_t *async_writer_open(int fd, size_t buffer_size, int backend) {
+    (void)fd;
+    (void)buffer_size;
+    (void)backend;
+    return NULL;
+}
+
+uint8_t *async_writer_buffer(async_writer_t *writer) {
+    (void)writer;
+    return NULL;
+}
+
+int async_writer_submit(async_writer_t *writer, size_t size) {
+    (void)writer;
+    (void)size;
+    return -1;
+}
+
+int async_writer_close(async_writer_t *writer) {
+    (void)writer;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @file base64_simd.c
+ * @brief ssse3/avx2 base64 encode and decode kernels
+ *
+ * the encoder splits 3 bytes into 4 6-bit indices with multiplies and maps
+ * them to ascii with one pshufb, the decoder validates with two nibble
+ * lookups and packs 4 characters back into 3 bytes with multiply-adds.
+ */
+
+#include "../include/simd.h"
+
+#ifdef ISENCHEF_X86
+
+#include <immintrin.h>
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+/* 6-bit index -> ascii offset, selected by a saturated-subtract key */
+#define ENCODE_SHIFT_LUT                                                                          \
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,      \
+        '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0
+
+/* bits set in both lookups mean "not a base64 character" */
+#define DECODE_LUT_LO                                                                              \
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+#define DECODE_LUT_HI                                                                              \
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+/* ascii -> 6-bit value offset, by high nibble ('/' moved to slot 1) */
+#define DECODE_LUT_ROLL 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+
+/* turn 12 bytes (spread as b1 b0 b2 b1 per dword) into 16 characters */
+SSSE3 static inline __m128i encode_spread_ssse3(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)),
+                                   _mm_set1_epi32(0x04000040));
+    __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)),
+                                  _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(high, low);
+
+    __m128i key = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    key = _mm_or_si128(key, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices),
+                                          _mm_set1_epi8(13)));
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(_mm_setr_epi8(ENCODE_SHIFT_LUT), key));
+}
+
+SSSE3 size_t base64_encode_ssse3(const uint8_t *input, size_t input_size, char *output) {
+    size_t i = 0;
+    size_t o = 0;
+
+    /* 12 bytes used per step, but the load reads 16 */
+    for (; i + 16 <= input_size; i += 12, o += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(input + i));
+        _mm_storeu_si128((__m128i *)(output + o), encode_spread_ssse3(in));
+    }
+    return i;
+}
+
+AVX2 size_t base64_encode_avx2(const uint8_t *input, size_t input_size, char *output) {
+    const __m256i spread = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                           10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shift_lut = _mm256_setr_epi8(ENCODE_SHIFT_LUT, ENCODE_SHIFT_LUT);
+    size_t i = 0;
+    size_t o = 0;
+
+    /* 24 bytes used per step, 12 in each lane, the second load reads up to i + 28 */
+    for (; i + 28 <= input_size; i += 24, o += 32) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(input + i))),
+            _mm_loadu_si128((const __m128i *)(input + i + 12)), 1);
+        in = _mm256_shuffle_epi8(in, spread);
+        __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)),
+                                          _mm256_set1_epi32(0x04000040));
+        __m256i low = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)),
+                                         _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(high, low);
+
+        __m256i key = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        key = _mm256_or_si256(key, _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(shift_lut, key));
+        _mm256_storeu_si256((__m256i *)(output + o), chars);
+    }
+    return i;
+}
+
+/* mask of the base64 alphabet characters among 16 */
+SSSE3 static inline unsigned valid16(__m128i chars) {
+    __m128i lo = _mm_shuffle_epi8(_mm_setr_epi8(DECODE_LUT_LO),
+                                  _mm_and_si128(chars, _mm_set1_epi8(0x0F)));
+    __m128i hi = _mm_shuffle_epi8(
+        _mm_setr_epi8(DECODE_LUT_HI),
+        _mm_and_si128(_mm_srli_epi32(chars, 4), _mm_set1_epi8(0x0F)));
+    __m128i valid = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+    return (unsigned)_mm_movemask_epi8(valid);
+}
+
+/* mask of isspace characters among 16 */
+SSSE3 static inline unsigned space16(__m128i chars) {
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                              _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('\t' - 1)),
+                                            _mm_cmplt_epi8(chars, _mm_set1_epi8('\r' + 1))));
+    return (unsigned)_mm_movemask_epi8(ws);
+}
+
+/* 16 valid characters -> 12 bytes at the front of the register */
+SSSE3 static inline __m128i decode16(__m128i chars) {
+    __m128i hi = _mm_and_si128(_mm_srli_epi32(chars, 4), _mm_set1_epi8(0x0F));
+    __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+    __m128i roll = _mm_shuffle_epi8(_mm_setr_epi8(DECODE_LUT_ROLL), _mm_add_epi8(slash, hi));
+    __m128i values = _mm_add_epi8(chars, roll);
+
+    __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(words,
+                            _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+/*
+ * one step of the 16-wide decoder: a whole clean block when the decoder is
+ * on a quad boundary, the clean quads in front of a line break, or a single
+ * character otherwise. returns 0 on padding or an invalid character.
+ */
+SSSE3 static inline int decode_step16(const char *base64, uint8_t *output,
+                                      base64_cursor_t *cursor) {
+    static const int8_t roll[16] = {DECODE_LUT_ROLL};
+    __m128i chars = _mm_loadu_si128((const __m128i *)(base64 + cursor->in));
+    unsigned valid = valid16(chars);
+
+    if (cursor->bit_count == 0) {
+        /* number of leading valid characters, rounded down to whole quads */
+        size_t quads = (size_t)__builtin_ctz(~valid | 0x10000) & ~(size_t)3;
+        if (quads > 0) {
+            _mm_storeu_si128((__m128i *)(output + cursor->out), decode16(chars));
+            cursor->out += quads / 4 * 3;
+            cursor->in += quads;
+            return 1;
+        }
+    }
+
+    uint8_t c = (uint8_t)base64[cursor->in];
+    if (!(valid & 1)) {
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            cursor->in++;
+            return 1;
+        }
+        return 0;
+    }
+    int value = (c == '/') ? 63 : c + roll[c >> 4];
+    cursor->bits = (cursor->bits << 6) | (uint32_t)value;
+    cursor->bit_count += 6;
+    if (cursor->bit_count >= 8) {
+        output[cursor->out++] = (uint8_t)(cursor->bits >> (cursor->bit_count - 8));
+        cursor->bit_count -= 8;
+    }
+    cursor->in++;
+    return 1;
+}
+
+SSSE3 void base64_decode_ssse3(const char *base64, size_t base64_len, uint8_t *output,
+                               size_t output_size, base64_cursor_t *cursor) {
+    /* local copy, so stores into output cannot alias the position */
+    base64_cursor_t at = *cursor;
+
+    /* every step stores 16 bytes at most */
+    while (at.in + 16 <= base64_len && output_size - at.out >= 16) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)(base64 + at.in));
+        if (at.bit_count == 0 && valid16(chars) == 0xFFFF) {
+            _mm_storeu_si128((__m128i *)(output + at.out), decode16(chars));
+            at.out += 12;
+            at.in += 16;
+        } else if (!decode_step16(base64, output, &at)) {
+            break;  /* padding or invalid character, the scalar code decides */
+        }
+    }
+    *cursor = at;
+}
+
+AVX2 void base64_decode_avx2(const char *base64, size_t base64_len, uint8_t *output,
+                             size_t output_size, base64_cursor_t *cursor) {
+    const __m256i lut_lo = _mm256_setr_epi8(DECODE_LUT_LO, DECODE_LUT_LO);
+    const __m256i lut_hi = _mm256_setr_epi8(DECODE_LUT_HI, DECODE_LUT_HI);
+    const __m256i lut_roll = _mm256_setr_epi8(DECODE_LUT_ROLL, DECODE_LUT_ROLL);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    base64_cursor_t at = *cursor;
+
+    while (at.in + 32 <= base64_len && output_size - at.out >= 32) {
+        __m256i chars = _mm256_loadu_si256((const __m256i *)(base64 + at.in));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(chars, 4), nibble);
+        __m256i lo = _mm256_and_si256(chars, nibble);
+        __m256i check = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo),
+                                         _mm256_shuffle_epi8(lut_hi, hi));
+
+        if (at.bit_count == 0 && _mm256_testz_si256(check, check)) {
+            __m256i slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+            __m256i values = _mm256_add_epi8(
+                chars, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(slash, hi)));
+            __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+            __m256i bytes = _mm256_shuffle_epi8(
+                words, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            /* close the 4-byte gap between the two 12-byte lanes */
+            bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+            _mm256_storeu_si256((__m256i *)(output + at.out), bytes);
+            at.out += 24;
+            at.in += 32;
+        } else if (!decode_step16(base64, output, &at)) {
+            break;  /* padding or invalid character */
+        }
+    }
+    *cursor = at;
+}
+
+#endif /* ISENCHEF_X86 */
@@ -0,0 +1,300 @@
+/**
+ * @file batch.c
+ * @brief many jobs in one process, spread over the worker pool
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "../include/batch.h"
+#include "../include/processor.h"
+#include "../include/workers.h"
+
+typedef struct {
+    config_t config;
+    char **argv;       /* manifest tokens the config points into */
+    char *input;       /* directory mode paths */
+    char *output;
+    int parsed;        /* config came from parse_arguments, free_config it */
+} batch_job_t;
+
+typedef struct {
+    batch_job_t *jobs;
+    size_t count;
+    size_t capacity;
+    char *manifest;         /* manifest text the tokens point into */
+    io_scratch_t *scratch;  /* one set of buffers per thread */
+    int *free_slots;
+    int free_count;
+    pthread_mutex_t lock;   /* scratch slots, counters and status lines */
+    size_t failed;
+    uint64_t bytes;
+} batch_t;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static batch_job_t *add_job(batch_t *batch) {
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 64;
+        batch_job_t *jobs = (batch_job_t *)realloc(batch->jobs, capacity * sizeof(batch_job_t));
+        if (!jobs) {
+            fprintf(stderr, "memory allocation failed\n");
+            return NULL;
+        }
+        batch->jobs = jobs;
+        batch->capacity = capacity;
+    }
+    batch_job_t *job = &batch->jobs[batch->count++];
+    memset(job, 0, sizeof(batch_job_t));
+    return job;
+}
+
+static int load_manifest(batch_t *batch, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    size_t line_number = 0;
+
+    if (!file) {
+        perror("opening batch manifest");
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    batch->manifest = (char *)malloc(size + 1);
+    if (!batch->manifest) {
+        fprintf(stderr, "memory allocation failed\n");
+        fclose(file);
+        return -1;
+    }
+    size = fread(batch->manifest, 1, size, file);
+    batch->manifest[size] = '\0';
+    fclose(file);
+
+    char *line = batch->manifest;
+    while (line) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        line_number++;
+
+        char *start = line + strspn(line, " \t\r");
+        line = next;
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+
+        batch_job_t *job = add_job(batch);
+        int argc;
+        if (!job || !(job->argv = split_arguments(start, &argc))) {
+            return -1;
+        }
+        int parsed = parse_arguments(argc, job->argv, &job->config);
+        job->parsed = 1;
+        if (parsed != 0) {
+            fprintf(stderr, "%s:%zu: invalid job\n", filename, line_number);
+            return -1;
+        }
+        if (job->config.batch_file || job->config.batch_dir || job->config.serve_socket) {
+            fprintf(stderr, "%s:%zu: batch jobs cannot start other batches or a server\n",
+                    filename, line_number);
+            return -1;
+        }
+        if (!job->config.input_file) {
+            fprintf(stderr, "%s:%zu: job has no --in\n", filename, line_number);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    char *path = (char *)malloc(dir_len + name_len + 2);
+
+    if (!path) {
+        fprintf(stderr, "memory allocation failed\n");
+        return NULL;
+    }
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+
+/* add a job for every regular file below in_dir, mirroring the tree in out_dir */
+static int walk_directory(batch_t *batch, const config_t *config, const char *in_dir,
+                          const char *out_dir, const struct stat *out_root) {
+    DIR *dir;
+    struct dirent *entry;
+    int result = 0;
+
+    if (out_dir && mkdir(out_dir, 0777) < 0 && errno != EEXIST) {
+        perror("creating output directory");
+        return -1;
+    }
+    dir = opendir(in_dir);
+    if (!dir) {
+        perror("opening input directory");
+        return -1;
+    }
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        struct stat st;
+
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char *input = join_path(in_dir, entry->d_name);
+        char *output = out_dir ? join_path(out_dir, entry->d_name) : NULL;
+        if (!input || (out_dir && !output) || lstat(input, &st) < 0) {
+            free(input);
+            free(output);
+            result = -1;
+            break;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            /* an output tree inside the input tree is not walked */
+            if (!out_root || st.st_dev != out_root->st_dev || st.st_ino != out_root->st_ino) {
+                result = walk_directory(batch, config, input, output, out_root);
+            }
+            free(input);
+            free(output);
+        } else if (S_ISREG(st.st_mode)) {
+            batch_job_t *job = add_job(batch);
+            if (!job) {
+                free(input);
+                free(output);
+                result = -1;
+                break;
+            }
+            job->config = *config;
+            job->config.batch_dir = NULL;
+            job->input = input;
+            job->output = output;
+            job->config.input_file = input;
+            job->config.output_file = output ? output : input;
+        } else {
+            free(input);
+            free(output);
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+static int load_directory(batch_t *batch, const config_t *config) {
+    struct stat out_root;
+    const char *out_dir = config->in_place ? NULL : config->output_file;
+
+    if (out_dir) {
+        if (mkdir(out_dir, 0777) < 0 && errno != EEXIST) {
+            perror("creating output directory");
+            return -1;
+        }
+        if (stat(out_dir, &out_root) < 0 || !S_ISDIR(out_root.st_mode)) {
+            fprintf(stderr, "not a directory: %s\n", out_dir);
+            return -1;
+        }
+    }
+    return walk_directory(batch, config, config->batch_dir, out_dir,
+                          out_dir ? &out_root : NULL);
+}
+
+static void run_job(void *arg, size_t index) {
+    batch_t *batch = (batch_t *)arg;
+    batch_job_t *job = &batch->jobs[index];
+    struct stat st;
+    uint64_t size = 0;
+
+    if (stat(job->config.input_file, &st) == 0) {
+        size = (uint64_t)st.st_size;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    int slot = batch->free_slots[--batch->free_count];
+    pthread_mutex_unlock(&batch->lock);
+
+    double start = now();
+    int result = execute_job(&job->config, &batch->scratch[slot]);
+    double elapsed = now() - start;
+
+    pthread_mutex_lock(&batch->lock);
+    batch->free_slots[batch->free_count++] = slot;
+    if (result < 0) {
+        batch->failed++;
+        printf("failed %s -> %s\n", job->config.input_file, job->config.output_file);
+    } else {
+        batch->bytes += size;
+        printf("ok     %s -> %s (%llu bytes, %.2f ms)\n", job->config.input_file,
+               job->config.output_file, (unsigned long long)size, elapsed * 1000.0);
+    }
+    pthread_mutex_unlock(&batch->lock);
+}
+
+int batch_execute(const config_t *config) {
+    batch_t batch;
+    int slots = workers_count();
+    int result = -1;
+
+    memset(&batch, 0, sizeof(batch));
+    pthread_mutex_init(&batch.lock, NULL);
+
+    if (config->batch_file) {
+        if (load_manifest(&batch, config->batch_file) < 0) {
+            goto cleanup;
+        }
+    } else if (load_directory(&batch, config) < 0) {
+        goto cleanup;
+    }
+
+    batch.scratch = (io_scratch_t *)calloc((size_t)slots, sizeof(io_scratch_t));
+    batch.free_slots = (int *)malloc((size_t)slots * sizeof(int));
+    if (!batch.scratch || !batch.free_slots) {
+        fprintf(stderr, "memory allocation failed\n");
+        goto cleanup;
+    }
+    for (int i = 0; i < slots; i++) {
+        batch.free_slots[batch.free_count++] = i;
+    }
+
+    double start = now();
+    workers_run(batch.count, run_job, &batch);
+    double elapsed = now() - start;
+
+    double mib = (double)batch.bytes / (1024.0 * 1024.0);
+    printf("batch: %zu jobs, %zu failed, %.1f MiB in %.3f s (%.1f MiB/s)\n", batch.count,
+           batch.failed, mib, elapsed, (elapsed > 0.0) ? mib / elapsed : 0.0);
+    result = (batch.failed == 0) ? 0 : -1;
+
+cleanup:
+    for (size_t i = 0; i < batch.count; i++) {
+        if (batch.jobs[i].parsed) {
+            free_config(&batch.jobs[i].config);
+        }
+        free(batch.jobs[i].argv);
+        free(batch.jobs[i].input);
+        free(batch.jobs[i].output);
+    }
+    if (batch.scratch) {
+        for (int i = 0; i < slots; i++) {
+            free_scratch(&batch.scratch[i]);
+        }
+    }
+    free(batch.scratch);
+    free(batch.free_slots);
+    free(batch.jobs);
+    free(batch.manifest);
+    pthread_mutex_destroy(&batch.lock);
+    return result;
+}
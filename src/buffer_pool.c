@@ -0,0 +1,193 @@
+/**
+ * @file buffer_pool.c
+ * @brief process-wide pool of data buffers, recycled from one stage or job to the next
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/buffer_pool.h"
+#include "../include/stats.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#define PAGE_SIZE_MIN 4096
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#define PAGE_SIZE_MIN 4096
+#endif
+
+/* released buffers of a class, linked through their first bytes */
+typedef struct pool_entry {
+    struct pool_entry *next;
+} pool_entry_t;
+
+static pool_entry_t *free_lists[POOL_CLASSES];
+static size_t cached_bytes = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* class of a capacity, -1 for sizes the pool does not keep */
+static int class_of(size_t capacity) {
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        if (capacity == (size_t)1 << (POOL_MIN_SHIFT + i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* capacity handed out for a request */
+static size_t capacity_for(size_t size) {
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        size_t capacity = (size_t)1 << (POOL_MIN_SHIFT + i);
+        if (size <= capacity) {
+            return capacity;
+        }
+    }
+    /* too large to keep, rounded to pages only */
+    return (size + PAGE_SIZE_MIN - 1) / PAGE_SIZE_MIN * PAGE_SIZE_MIN;
+}
+
+#ifndef _WIN32
+
+/* a mapping starting on a huge page boundary, so the kernel can back it with huge pages */
+static void *map_huge(size_t capacity) {
+    size_t span = capacity + POOL_HUGE_MIN;
+    uint8_t *base = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t *start = (uint8_t *)(((uintptr_t)base + POOL_HUGE_MIN - 1) &
+                                 ~(uintptr_t)(POOL_HUGE_MIN - 1));
+    if (start > base) {
+        munmap(base, (size_t)(start - base));
+    }
+    if (start + capacity < base + span) {
+        munmap(start + capacity, (size_t)(base + span - (start + capacity)));
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(start, capacity, MADV_HUGEPAGE);
+#endif
+    return start;
+}
+
+static void *system_alloc(size_t capacity) {
+    void *buffer;
+
+    if (capacity >= POOL_HUGE_MIN) {
+        return map_huge(capacity);
+    }
+    if (posix_memalign(&buffer, PAGE_SIZE_MIN, capacity) != 0) {
+        return NULL;
+    }
+    return buffer;
+}
+
+static void system_free(void *buffer, size_t capacity) {
+    if (capacity >= POOL_HUGE_MIN) {
+        munmap(buffer, capacity);
+    } else {
+        free(buffer);
+    }
+}
+
+#else
+
+static void *system_alloc(size_t capacity) {
+    return _aligned_malloc(capacity, PAGE_SIZE_MIN);
+}
+
+static void system_free(void *buffer, size_t capacity) {
+    (void)capacity;
+    _aligned_free(buffer);
+}
+
+#endif
+
+void *pool_alloc(size_t size, size_t *capacity) {
+    size_t wanted = capacity_for(size ? size : 1);
+    int index = class_of(wanted);
+    void *buffer = NULL;
+
+    if (index >= 0) {
+        pthread_mutex_lock(&lock);
+        pool_entry_t *entry = free_lists[index];
+        if (entry) {
+            free_lists[index] = entry->next;
+            cached_bytes -= wanted;
+            buffer = entry;
+        }
+        pthread_mutex_unlock(&lock);
+    }
+    if (buffer) {
+        STATS_REUSE();
+    } else {
+        buffer = system_alloc(wanted);
+        STATS_ALLOC();
+        if (!buffer) {
+            fprintf(stderr, "memory allocation failed\n");
+            *capacity = 0;
+            return NULL;
+        }
+    }
+    *capacity = wanted;
+    return buffer;
+}
+
+void *pool_grow(void *buffer, size_t *capacity, size_t used, size_t size) {
+    size_t grown;
+    void *bigger;
+
+    if (buffer && *capacity >= size) {
+        return buffer;
+    }
+    bigger = pool_alloc(size, &grown);
+    if (!bigger) {
+        return NULL;
+    }
+    if (buffer) {
+        memcpy(bigger, buffer, used);
+        pool_free(buffer, *capacity);
+    }
+    *capacity = grown;
+    return bigger;
+}
+
+void pool_shrink(void *buffer, size_t capacity, size_t used) {
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+    /* only whole huge pages, splitting one would cost more than it frees */
+    size_t keep = (used + POOL_HUGE_MIN - 1) / POOL_HUGE_MIN * POOL_HUGE_MIN;
+    if (capacity >= POOL_HUGE_MIN && keep < capacity) {
+        madvise((uint8_t *)buffer + keep, capacity - keep, MADV_DONTNEED);
+    }
+#else
+    (void)buffer;
+    (void)capacity;
+    (void)used;
+#endif
+}
+
+void pool_free(void *buffer, size_t capacity) {
+    int index = class_of(capacity);
+
+    if (!buffer) {
+        return;
+    }
+    if (index >= 0) {
+        pthread_mutex_lock(&lock);
+        if (cached_bytes + capacity <= POOL_CACHE_MAX) {
+            pool_entry_t *entry = (pool_entry_t *)buffer;
+            entry->next = free_lists[index];
+            free_lists[index] = entry;
+            cached_bytes += capacity;
+            buffer = NULL;
+        }
+        pthread_mutex_unlock(&lock);
+    }
+    if (buffer) {
+        system_free(buffer, capacity);
+    }
+}
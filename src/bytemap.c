@@ -0,0 +1,67 @@
+/**
+ * @file bytemap.c
+ * @brief stateless per-byte substitutions compiled into one lookup table
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/bytemap.h"
+#include "../include/actions.h"
+#include "../include/simd.h"
+
+int bytemap_accepts(action_t action) {
+    return action == ACTION_CAESAR || action == ACTION_UPPERCASE || action == ACTION_LOWERCASE;
+}
+
+void bytemap_init(bytemap_t *map) {
+    for (int i = 0; i < 256; i++) {
+        map->table[i] = (uint8_t)i;
+    }
+    map->rows = 0;
+}
+
+int bytemap_append(bytemap_t *map, action_t action, int shift) {
+    /* running the action over the table composes it with what is already there */
+    switch (action) {
+        case ACTION_CAESAR:
+            action_caesar(map->table, sizeof(map->table), shift);
+            break;
+        case ACTION_UPPERCASE:
+            action_uppercase(map->table, sizeof(map->table));
+            break;
+        case ACTION_LOWERCASE:
+            action_lowercase(map->table, sizeof(map->table));
+            break;
+        default:
+            return -1;
+    }
+
+    map->rows = 0;
+    for (int i = 0; i < 256; i++) {
+        if (map->table[i] != (uint8_t)i) {
+            map->rows |= (uint16_t)(1u << (i >> 4));
+        }
+    }
+    return 0;
+}
+
+void bytemap_apply(const bytemap_t *map, const uint8_t *src, uint8_t *dst, size_t size) {
+    size_t done = 0;
+
+    switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+        case CPU_AVX2:
+            done = bytemap_apply_avx2(map->table, map->rows, src, dst, size);
+            break;
+        case CPU_SSSE3:
+            done = bytemap_apply_ssse3(map->table, map->rows, src, dst, size);
+            break;
+#endif
+        default:
+            break;
+    }
+    for (size_t i = done; i < size; i++) {
+        dst[i] = map->table[src[i]];
+    }
+}
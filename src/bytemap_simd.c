@@ -0,0 +1,80 @@
+/**
+ * @file bytemap_simd.c
+ * @brief ssse3/avx2 nibble-lookup kernels for compiled byte maps
+ *
+ * the 256-entry table is seen as 16 rows of 16 bytes. the low nibble of
+ * each input byte indexes a row with pshufb and the high nibble selects
+ * which row result to keep. rows equal to the identity are skipped, so a
+ * letters-only map costs four lookups per block.
+ */
+
+#include "../include/simd.h"
+
+#ifdef ISENCHEF_X86
+
+#include <immintrin.h>
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSSE3 size_t bytemap_apply_ssse3(const uint8_t table[256], uint16_t rows, const uint8_t *src,
+                                 uint8_t *dst, size_t size) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i lut[16];
+    __m128i row_id[16];
+    int active = 0;
+    size_t i = 0;
+
+    for (int row = 0; row < 16; row++) {
+        if (rows & (1u << row)) {
+            lut[active] = _mm_loadu_si128((const __m128i *)(table + row * 16));
+            row_id[active] = _mm_set1_epi8((char)row);
+            active++;
+        }
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        __m128i lo = _mm_and_si128(v, nibble);
+        __m128i out = v;
+        for (int r = 0; r < active; r++) {
+            __m128i hit = _mm_cmpeq_epi8(hi, row_id[r]);
+            __m128i mapped = _mm_shuffle_epi8(lut[r], lo);
+            out = _mm_or_si128(_mm_andnot_si128(hit, out), _mm_and_si128(hit, mapped));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    return i;
+}
+
+AVX2 size_t bytemap_apply_avx2(const uint8_t table[256], uint16_t rows, const uint8_t *src,
+                               uint8_t *dst, size_t size) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i lut[16];
+    __m256i row_id[16];
+    int active = 0;
+    size_t i = 0;
+
+    for (int row = 0; row < 16; row++) {
+        if (rows & (1u << row)) {
+            lut[active] = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)(table + row * 16)));
+            row_id[active] = _mm256_set1_epi8((char)row);
+            active++;
+        }
+    }
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+        __m256i lo = _mm256_and_si256(v, nibble);
+        __m256i out = v;
+        for (int r = 0; r < active; r++) {
+            __m256i hit = _mm256_cmpeq_epi8(hi, row_id[r]);
+            out = _mm256_blendv_epi8(out, _mm256_shuffle_epi8(lut[r], lo), hit);
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), out);
+    }
+    return i;
+}
+
+#endif /* ISENCHEF_X86 */
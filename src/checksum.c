@@ -0,0 +1,435 @@
+/**
+ * @file checksum.c
+ * @brief checksums taken on the data as it goes through a job (--checksum)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/checksum.h"
+#include "../include/simd.h"
+
+static const char *const algorithm_names[] = {"crc32c", "xxh64", "sha256"};
+static const char *const point_names[] = {"decoded", "transformed", "output"};
+
+/* crc32c, reflected castagnoli polynomial, eight bytes per step */
+#define CRC32C_POLY 0x82f63b78u
+
+static uint32_t crc32c_table[8][256];
+
+__attribute__((constructor)) static void crc32c_build(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = crc32c_table[t - 1][i];
+            crc32c_table[t][i] = (prev >> 8) ^ crc32c_table[0][prev & 0xff];
+        }
+    }
+}
+
+static uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t size) {
+    size_t i = 0;
+
+#ifdef ISENCHEF_X86
+    if (cpu_has_crc32c()) {
+        i = crc32c_sse42(&crc, data, size);
+    }
+#endif
+    for (; i + 8 <= size; i += 8) {
+        uint32_t low = crc ^ ((uint32_t)data[i] | (uint32_t)data[i + 1] << 8 |
+                              (uint32_t)data[i + 2] << 16 | (uint32_t)data[i + 3] << 24);
+        crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][(low >> 8) & 0xff] ^
+              crc32c_table[5][(low >> 16) & 0xff] ^ crc32c_table[4][low >> 24] ^
+              crc32c_table[3][data[i + 4]] ^ crc32c_table[2][data[i + 5]] ^
+              crc32c_table[1][data[i + 6]] ^ crc32c_table[0][data[i + 7]];
+    }
+    for (; i < size; i++) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ data[i]) & 0xff];
+    }
+    return crc;
+}
+
+/* xxhash64 */
+#define XXH_P1 11400714785074694791ull
+#define XXH_P2 14029467366897019727ull
+#define XXH_P3 1609587929392839161ull
+#define XXH_P4 9650029242287828579ull
+#define XXH_P5 2870177450012600261ull
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64le(const uint8_t *p) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#else
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+#endif
+}
+
+static uint32_t read32le(const uint8_t *p) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#else
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+#endif
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_P2;
+    return rotl64(acc, 31) * XXH_P1;
+}
+
+static uint64_t xxh64_merge(uint64_t acc, uint64_t value) {
+    acc ^= xxh64_round(0, value);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+static void xxh64_init(xxh64_state_t *state) {
+    memset(state, 0, sizeof(*state));
+    state->v[0] = XXH_P1 + XXH_P2;
+    state->v[1] = XXH_P2;
+    state->v[2] = 0;
+    state->v[3] = 0 - XXH_P1;
+}
+
+static void xxh64_stripes(xxh64_state_t *state, const uint8_t *data, size_t stripes) {
+    uint64_t v0 = state->v[0], v1 = state->v[1], v2 = state->v[2], v3 = state->v[3];
+
+    for (size_t s = 0; s < stripes; s++, data += 32) {
+        v0 = xxh64_round(v0, read64le(data));
+        v1 = xxh64_round(v1, read64le(data + 8));
+        v2 = xxh64_round(v2, read64le(data + 16));
+        v3 = xxh64_round(v3, read64le(data + 24));
+    }
+    state->v[0] = v0;
+    state->v[1] = v1;
+    state->v[2] = v2;
+    state->v[3] = v3;
+}
+
+static void xxh64_update(xxh64_state_t *state, const uint8_t *data, size_t size) {
+    state->total += size;
+    if (state->buffered) {
+        size_t n = 32 - state->buffered;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(state->buffer + state->buffered, data, n);
+        state->buffered += n;
+        data += n;
+        size -= n;
+        if (state->buffered < 32) {
+            return;
+        }
+        xxh64_stripes(state, state->buffer, 1);
+        state->buffered = 0;
+    }
+    xxh64_stripes(state, data, size / 32);
+    data += size / 32 * 32;
+    size %= 32;
+    memcpy(state->buffer, data, size);
+    state->buffered = size;
+}
+
+static uint64_t xxh64_digest(const xxh64_state_t *state) {
+    const uint8_t *p = state->buffer;
+    size_t left = state->buffered;
+    uint64_t h;
+
+    if (state->total >= 32) {
+        h = rotl64(state->v[0], 1) + rotl64(state->v[1], 7) + rotl64(state->v[2], 12) +
+            rotl64(state->v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = xxh64_merge(h, state->v[i]);
+        }
+    } else {
+        h = XXH_P5;
+    }
+    h += state->total;
+    for (; left >= 8; left -= 8, p += 8) {
+        h ^= xxh64_round(0, read64le(p));
+        h = rotl64(h, 27) * XXH_P1 + XXH_P4;
+    }
+    if (left >= 4) {
+        h ^= (uint64_t)read32le(p) * XXH_P1;
+        h = rotl64(h, 23) * XXH_P2 + XXH_P3;
+        left -= 4;
+        p += 4;
+    }
+    for (; left > 0; left--, p++) {
+        h ^= *p * XXH_P5;
+        h = rotl64(h, 11) * XXH_P1;
+    }
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* sha-256, fips 180-4 */
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+    0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+    0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+    0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+    0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+    0xc67178f2};
+
+static uint32_t rotr32(uint32_t x, int r) {
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256_init(sha256_state_t *state) {
+    static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memset(state, 0, sizeof(*state));
+    memcpy(state->h, initial, sizeof(initial));
+}
+
+static void sha256_blocks(uint32_t h[8], const uint8_t *data, size_t blocks) {
+    uint32_t w[64];
+
+#ifdef ISENCHEF_X86
+    if (cpu_has_sha256()) {
+        size_t done = sha256_shani(h, sha256_k, data, blocks);
+        data += done * 64;
+        blocks -= done;
+    }
+#endif
+    for (size_t b = 0; b < blocks; b++, data += 64) {
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)data[i * 4] << 24 | (uint32_t)data[i * 4 + 1] << 16 |
+                   (uint32_t)data[i * 4 + 2] << 8 | (uint32_t)data[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], bb = h[1], c = h[2], d = h[3];
+        uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+            uint32_t t1 = hh + s1 + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+            uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+            uint32_t t2 = s0 + ((a & bb) ^ (a & c) ^ (bb & c));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = bb;
+            bb = a;
+            a = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += bb;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+}
+
+static void sha256_update(sha256_state_t *state, const uint8_t *data, size_t size) {
+    state->total += size;
+    if (state->buffered) {
+        size_t n = 64 - state->buffered;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(state->buffer + state->buffered, data, n);
+        state->buffered += n;
+        data += n;
+        size -= n;
+        if (state->buffered < 64) {
+            return;
+        }
+        sha256_blocks(state->h, state->buffer, 1);
+        state->buffered = 0;
+    }
+    sha256_blocks(state->h, data, size / 64);
+    data += size / 64 * 64;
+    size %= 64;
+    memcpy(state->buffer, data, size);
+    state->buffered = size;
+}
+
+static void sha256_digest(const sha256_state_t *state, uint8_t digest[32]) {
+    uint8_t tail[128];
+    uint32_t h[8];
+    uint64_t bits = state->total * 8;
+    size_t n = state->buffered;
+    size_t padded = (n < 56) ? 64 : 128;
+
+    memcpy(h, state->h, sizeof(h));
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, state->buffer, n);
+    tail[n] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        tail[padded - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    sha256_blocks(h, tail, padded / 64);
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(h[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+static int find_name(const char *const names[], int count, const char *name, size_t len) {
+    for (int i = 0; i < count; i++) {
+        if (strlen(names[i]) == len && strncmp(names[i], name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int checksum_parse(const char *text, checksum_spec_t *spec) {
+    const char *colon = strchr(text, ':');
+    size_t len = colon ? (size_t)(colon - text) : strlen(text);
+
+    spec->algorithm = find_name(algorithm_names, 3, text, len);
+    spec->point = colon ? find_name(point_names, 3, colon + 1, strlen(colon + 1))
+                        : CHECKSUM_OUTPUT;
+    if (spec->algorithm < 0 || spec->point < 0) {
+        fprintf(stderr, "invalid checksum: %s (crc32c, xxh64 or sha256, then :decoded, "
+                        ":transformed or :output)\n", text);
+        return -1;
+    }
+    return 0;
+}
+
+void checksum_init(checksum_t *sum, int algorithm, int point) {
+    sum->algorithm = algorithm;
+    sum->point = point;
+    if (algorithm == CHECKSUM_CRC32C) {
+        sum->state.crc = 0xffffffffu;
+    } else if (algorithm == CHECKSUM_XXH64) {
+        xxh64_init(&sum->state.xxh);
+    } else {
+        sha256_init(&sum->state.sha);
+    }
+}
+
+void checksum_update(checksum_t *sum, const void *data, size_t size) {
+    if (sum->algorithm == CHECKSUM_CRC32C) {
+        sum->state.crc = crc32c_update(sum->state.crc, (const uint8_t *)data, size);
+    } else if (sum->algorithm == CHECKSUM_XXH64) {
+        xxh64_update(&sum->state.xxh, (const uint8_t *)data, size);
+    } else {
+        sha256_update(&sum->state.sha, (const uint8_t *)data, size);
+    }
+}
+
+size_t checksum_final(const checksum_t *sum, uint8_t digest[CHECKSUM_DIGEST_MAX]) {
+    if (sum->algorithm == CHECKSUM_SHA256) {
+        sha256_digest(&sum->state.sha, digest);
+        return 32;
+    }
+
+    uint64_t value = (sum->algorithm == CHECKSUM_CRC32C) ? ~sum->state.crc & 0xffffffffu
+                                                         : xxh64_digest(&sum->state.xxh);
+    size_t length = (sum->algorithm == CHECKSUM_CRC32C) ? 4 : 8;
+    for (size_t i = 0; i < length; i++) {
+        digest[i] = (uint8_t)(value >> (8 * (length - 1 - i)));
+    }
+    return length;
+}
+
+int checksum_set_init(checksum_set_t *set, const config_t *config, int raw_output) {
+    set->sums = NULL;
+    set->count = 0;
+    set->raw_output = raw_output;
+    if (config->checksum_count == 0) {
+        return 0;
+    }
+    set->sums = (checksum_t *)malloc(config->checksum_count * sizeof(checksum_t));
+    if (!set->sums) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < config->checksum_count; i++) {
+        checksum_init(&set->sums[i], config->checksums[i].algorithm, config->checksums[i].point);
+    }
+    set->count = config->checksum_count;
+    return 0;
+}
+
+/* whether data taken at point feeds a sum reading at sum_point */
+static int feeds(const checksum_set_t *set, int point, int sum_point) {
+    return sum_point == point ||
+           (set->raw_output && point == CHECKSUM_TRANSFORMED && sum_point == CHECKSUM_OUTPUT);
+}
+
+int checksum_set_wants(const checksum_set_t *set, int point) {
+    if (!set) {
+        return 0;
+    }
+    for (size_t i = 0; i < set->count; i++) {
+        if (feeds(set, point, set->sums[i].point)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void checksum_set_update(checksum_set_t *set, int point, const void *data, size_t size) {
+    if (!set) {
+        return;
+    }
+    for (size_t i = 0; i < set->count; i++) {
+        if (feeds(set, point, set->sums[i].point)) {
+            checksum_update(&set->sums[i], data, size);
+        }
+    }
+}
+
+void checksum_set_print(const checksum_set_t *set, FILE *out, int point, const char *file) {
+    uint8_t digest[CHECKSUM_DIGEST_MAX];
+    char hex[CHECKSUM_DIGEST_MAX * 2 + 1];
+
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->sums[i].point != point) {
+            continue;
+        }
+        size_t length = checksum_final(&set->sums[i], digest);
+        for (size_t j = 0; j < length; j++) {
+            snprintf(hex + j * 2, 3, "%02x", digest[j]);
+        }
+        fprintf(out, "%s %s %s %s\n", algorithm_names[set->sums[i].algorithm],
+                point_names[point], hex, file);
+    }
+}
+
+void checksum_set_free(checksum_set_t *set) {
+    free(set->sums);
+    set->sums = NULL;
+    set->count = 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file checksum_simd.c
+ * @brief sse4.2 kernel for crc32c and sha extensions kernel for sha-256
+ *
+ * the crc32 instruction folds eight bytes per step into the castagnoli
+ * crc, the same reflected polynomial the table code uses. sha256rnds2
+ * runs two rounds per instruction on the state kept as abef/cdgh halves.
+ */
+
+#include <string.h>
+#include "../include/simd.h"
+
+#ifdef ISENCHEF_X86
+
+#include <immintrin.h>
+
+#define SSE42 __attribute__((target("sse4.2")))
+#define SHANI __attribute__((target("sha,ssse3,sse4.1")))
+
+SSE42 size_t crc32c_sse42(uint32_t *crc, const uint8_t *data, size_t size) {
+    size_t i = 0;
+
+#ifdef __x86_64__
+    uint64_t value = *crc;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        value = _mm_crc32_u64(value, word);
+    }
+    *crc = (uint32_t)value;
+#else
+    uint32_t value = *crc;
+    for (; i + 4 <= size; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, 4);
+        value = _mm_crc32_u32(value, word);
+    }
+    *crc = value;
+#endif
+    return i;
+}
+
+SHANI size_t sha256_shani(uint32_t h[8], const uint32_t k[64], const uint8_t *data,
+                          size_t blocks) {
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+
+    /* a b c d / e f g h to the abef / cdgh layout of the round instruction */
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0xb1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(h + 4)), 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (size_t b = 0; b < blocks; b++, data += 64) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i w[4];
+
+        for (int i = 0; i < 4; i++) {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), swap);
+        }
+        /* four rounds per group, the schedule of group g + 4 replaces group g */
+        for (int g = 0; g < 16; g++) {
+            __m128i msg = _mm_add_epi32(w[g & 3], _mm_loadu_si128((const __m128i *)(k + g * 4)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+            if (g < 12) {
+                __m128i next = _mm_sha256msg1_epu32(w[g & 3], w[(g + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[(g + 3) & 3], w[(g + 2) & 3], 4));
+                w[g & 3] = _mm_sha256msg2_epu32(next, w[(g + 3) & 3]);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128((__m128i *)h, _mm_blend_epi16(tmp, state1, 0xf0));
+    _mm_storeu_si128((__m128i *)(h + 4), _mm_alignr_epi8(state1, tmp, 8));
+    return blocks;
+}
+
+#endif /* ISENCHEF_X86 */
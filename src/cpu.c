@@ -0,0 +1,82 @@
+/**
+ * @file cpu.c
+ * @brief runtime cpu feature detection for the vectorized kernels
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/cpu.h"
+
+#ifdef ISENCHEF_X86
+#include <cpuid.h>
+#endif
+
+static cpu_level_t detected_level = CPU_SCALAR;
+static cpu_level_t supported_level = CPU_SCALAR;
+static int crc32c_supported = 0;
+static int sha256_supported = 0;
+
+static const char *const level_names[] = {"scalar", "sse2", "ssse3", "avx2"};
+
+/* runs before main (and when the library is loaded) so dispatch never races */
+__attribute__((constructor)) static void cpu_detect(void) {
+    cpu_level_t level = CPU_SCALAR;
+
+#ifdef ISENCHEF_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        level = CPU_SSE2;
+    }
+    if (level == CPU_SSE2 && __builtin_cpu_supports("ssse3")) {
+        level = CPU_SSSE3;
+    }
+    if (level == CPU_SSSE3 && __builtin_cpu_supports("avx2")) {
+        level = CPU_AVX2;
+    }
+    crc32c_supported = __builtin_cpu_supports("sse4.2");
+    /* sha extensions, cpuid leaf 7 ebx bit 29 */
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && __builtin_cpu_supports("sse4.1")) {
+        sha256_supported = (ebx >> 29) & 1;
+    }
+#endif
+    supported_level = level;
+
+    const char *forced = getenv("ISENCHEF_SIMD");
+    if (forced) {
+        for (int i = CPU_SCALAR; i <= CPU_AVX2; i++) {
+            if (strcmp(forced, level_names[i]) == 0 && (cpu_level_t)i < level) {
+                level = (cpu_level_t)i;
+            }
+        }
+    }
+    detected_level = level;
+}
+
+cpu_level_t cpu_level(void) {
+    return detected_level;
+}
+
+int cpu_set_level(cpu_level_t level) {
+    if (level > supported_level) {
+        return -1;
+    }
+    detected_level = level;
+    return 0;
+}
+
+cpu_level_t cpu_supported_level(void) {
+    return supported_level;
+}
+
+int cpu_has_crc32c(void) {
+    return crc32c_supported && detected_level > CPU_SCALAR;
+}
+
+int cpu_has_sha256(void) {
+    return sha256_supported && detected_level >= CPU_SSSE3;
+}
+
+const char *cpu_level_name(cpu_level_t level) {
+    return level_names[level];
+}
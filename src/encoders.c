@@ -6,8 +6,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <ctype.h>
+#include <stdatomic.h>
 #include "../include/encoders.h"
+#include "../include/simd.h"
+#include "../include/workers.h"
 
 static int hex_char_to_value(char c) {
     if (c >= '0' && c <= '9') {
@@ -29,128 +33,660 @@ static char value_to_hex_char(int value) {
     return '?';
 }
 
-int decode_hex(const char *hex, uint8_t *output, size_t output_size) {
-    size_t hex_len = strlen(hex);
-    size_t output_idx = 0;
+/* scalar hex decoder, carries on from wherever the kernels stopped, until the output is full */
+static int decode_hex_scalar(const char *hex, size_t hex_len, uint8_t *output,
+                             size_t output_size, hex_cursor_t *cursor) {
+    size_t output_idx = cursor->out;
+    int high = cursor->high;
+    size_t i;
 
     /* remove whitespace and handle pairs */
-    for (size_t i = 0; i < hex_len && output_idx < output_size; i++) {
+    for (i = cursor->in; i < hex_len; i++) {
+        if (high < 0 && output_idx >= output_size) {
+            break;
+        }
         if (isspace((unsigned char)hex[i])) {
             continue;
         }
-        int high = hex_char_to_value(hex[i]);
-        if (high < 0) {
+        int value = hex_char_to_value(hex[i]);
+        if (value < 0) {
             return -1;
         }
-        i++;
-        while (i < hex_len && isspace((unsigned char)hex[i])) {
-            i++;
+        if (high < 0) {
+            high = value;
+        } else {
+            if (output_idx >= output_size) {
+                break;  /* the high nibble came from a previous call with room left */
+            }
+            output[output_idx++] = (uint8_t)((high << 4) | value);
+            high = -1;
         }
-        if (i >= hex_len) {
-            /* odd number of hex digits, pad with 0 */
-            output[output_idx++] = (uint8_t)(high << 4);
+    }
+    cursor->in = i;
+    cursor->out = output_idx;
+    cursor->high = high;
+    return 0;
+}
+
+void hex_decoder_init(hex_decoder_t *decoder) {
+    decoder->high = -1;
+    decoder->consumed = 0;
+    decoder->produced = 0;
+}
+
+int hex_decoder_update(hex_decoder_t *decoder, const char *input, size_t input_len,
+                       uint8_t *output, size_t output_size, size_t *consumed, size_t *produced) {
+    hex_cursor_t cursor = {0, 0, decoder->high};
+    int result = 0;
+
+    *consumed = 0;
+    *produced = 0;
+    switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+        case CPU_AVX2:
+            result = hex_decode_avx2(input, input_len, output, output_size, &cursor);
+            break;
+        case CPU_SSSE3:
+            result = hex_decode_ssse3(input, input_len, output, output_size, &cursor);
+            break;
+        case CPU_SSE2:
+            result = hex_decode_sse2(input, input_len, output, output_size, &cursor);
+            break;
+#endif
+        default:
             break;
-        }
-        int low = hex_char_to_value(hex[i]);
-        if (low < 0) {
-            return -1;
-        }
-        output[output_idx++] = (uint8_t)((high << 4) | low);
     }
-    return (int)output_idx;
+    if (result < 0 || decode_hex_scalar(input, input_len, output, output_size, &cursor) < 0) {
+        return -1;
+    }
+    decoder->high = cursor.high;
+    decoder->consumed += cursor.in;
+    decoder->produced += cursor.out;
+    *consumed = cursor.in;
+    *produced = cursor.out;
+    return 0;
 }
 
-int encode_hex(const uint8_t *input, size_t input_size, char *output) {
-    for (size_t i = 0; i < input_size; i++) {
+int hex_decoder_final(hex_decoder_t *decoder, uint8_t *output, size_t output_size,
+                      size_t *produced) {
+    *produced = 0;
+    if (decoder->high < 0) {
+        return 0;
+    }
+    if (output_size == 0) {
+        return -1;
+    }
+    /* odd number of hex digits, pad with 0 */
+    output[0] = (uint8_t)(decoder->high << 4);
+    decoder->high = -1;
+    decoder->produced++;
+    *produced = 1;
+    return 0;
+}
+
+int decode_hex(const char *hex, uint8_t *output, size_t output_size) {
+    size_t decoded;
+
+    if (decode_hex_len(hex, strlen(hex), output, output_size, &decoded) < 0 ||
+        decoded > INT_MAX) {
+        return -1;
+    }
+    return (int)decoded;
+}
+
+int decode_hex_len(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                   size_t *decoded) {
+    hex_decoder_t decoder;
+    size_t consumed;
+    size_t produced;
+    size_t tail;
+
+    /* a full output ends the decode, the characters left are ignored */
+    hex_decoder_init(&decoder);
+    if (hex_decoder_update(&decoder, hex, hex_len, output, output_size, &consumed,
+                           &produced) < 0 ||
+        hex_decoder_final(&decoder, output + produced, output_size - produced, &tail) < 0) {
+        return -1;
+    }
+    *decoded = produced + tail;
+    return 0;
+}
+
+/* encode a range without the terminator, kernels first, scalar tail */
+static void encode_hex_range(const uint8_t *input, size_t input_size, char *output) {
+    size_t done = 0;
+
+    switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+        case CPU_AVX2:
+            done = hex_encode_avx2(input, input_size, output);
+            break;
+        case CPU_SSSE3:
+            done = hex_encode_ssse3(input, input_size, output);
+            break;
+        case CPU_SSE2:
+            done = hex_encode_sse2(input, input_size, output);
+            break;
+#endif
+        default:
+            break;
+    }
+    for (size_t i = done; i < input_size; i++) {
         output[i * 2] = value_to_hex_char((input[i] >> 4) & 0x0F);
         output[i * 2 + 1] = value_to_hex_char(input[i] & 0x0F);
     }
+}
+
+/* arguments shared by the slices of a parallel encode */
+typedef struct {
+    const uint8_t *input;
+    size_t input_size;
+    char *output;
+} encode_job_t;
+
+static void encode_hex_slice(void *arg, size_t index) {
+    encode_job_t *job = (encode_job_t *)arg;
+    size_t start = index * WORKERS_SLICE_SIZE;
+    size_t n = job->input_size - start;
+    if (n > WORKERS_SLICE_SIZE) {
+        n = WORKERS_SLICE_SIZE;
+    }
+    encode_hex_range(job->input + start, n, job->output + start * 2);
+}
+
+/* encode without the terminator, across the worker pool when the input is large */
+static void encode_hex_all(const uint8_t *input, size_t input_size, char *output) {
+    if (input_size >= WORKERS_MIN_PARALLEL && workers_count() > 1) {
+        encode_job_t job = {input, input_size, output};
+        workers_run((input_size + WORKERS_SLICE_SIZE - 1) / WORKERS_SLICE_SIZE,
+                    encode_hex_slice, &job);
+    } else {
+        encode_hex_range(input, input_size, output);
+    }
+}
+
+int encode_hex(const uint8_t *input, size_t input_size, char *output) {
+    encode_hex_all(input, input_size, output);
     output[input_size * 2] = '\0';
     return 0;
 }
 
+void hex_encoder_init(hex_encoder_t *encoder) {
+    encoder->consumed = 0;
+    encoder->produced = 0;
+}
+
+int hex_encoder_update(hex_encoder_t *encoder, const uint8_t *input, size_t input_size,
+                       char *output, size_t output_size, size_t *consumed, size_t *produced) {
+    size_t n = (input_size < output_size / 2) ? input_size : output_size / 2;
+
+    encode_hex_all(input, n, output);
+    encoder->consumed += n;
+    encoder->produced += n * 2;
+    *consumed = n;
+    *produced = n * 2;
+    return 0;
+}
+
+int hex_encoder_final(hex_encoder_t *encoder, char *output, size_t output_size,
+                      size_t *produced) {
+    (void)encoder;
+    (void)output;
+    (void)output_size;
+    *produced = 0;
+    return 0;
+}
+
 /* b64 alphabet */
 static const char base64_table[] = 
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-static int base64_char_to_value(char c) {
-    if (c >= 'A' && c <= 'Z') {
-        return c - 'A';
-    } else if (c >= 'a' && c <= 'z') {
-        return c - 'a' + 26;
-    } else if (c >= '0' && c <= '9') {
-        return c - '0' + 52;
-    } else if (c == '+') {
-        return 62;
-    } else if (c == '/') {
-        return 63;
-    } else if (c == '=') {
-        return -2;  /* padding */
-    }
-    return -1;  /* invalid */
-}
+/*
+ * value of each character: 0..63 for the alphabet, -2 for padding,
+ * -3 for whitespace (isspace in the C locale), -1 for anything else
+ */
+static const int8_t base64_values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -3, -3, -3, -3, -3, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -2, -1, -1,
+    -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
 
-int decode_base64(const char *base64, uint8_t *output, size_t output_size) {
-    size_t base64_len = strlen(base64);
-    size_t output_idx = 0;
-    int buffer = 0;
-    int bits_collected = 0;
-    for (size_t i = 0; i < base64_len; i++) {
-        if (isspace((unsigned char)base64[i])) {
+/* scalar base64 decoder, carries on from wherever the kernels stopped, until the output is full */
+static int decode_base64_scalar(const char *base64, size_t base64_len, uint8_t *output,
+                                size_t output_size, base64_cursor_t *cursor, int *padded) {
+    size_t output_idx = cursor->out;
+    uint32_t buffer = cursor->bits;
+    int bits_collected = cursor->bit_count;
+    size_t i;
+
+    for (i = cursor->in; i < base64_len; i++) {
+        int value = base64_values[(unsigned char)base64[i]];
+        if (value == -3) {
             continue;
         }
-        int value = base64_char_to_value(base64[i]);
         if (value == -1) {
             return -1;  /* invalid character */
         }
         if (value == -2) {
-            break;  /* padding, stop here */
+            /* padding, stop here and ignore the rest */
+            *padded = 1;
+            i = base64_len;
+            break;
         }
-        buffer = (buffer << 6) | value;
+        if (bits_collected >= 2 && output_idx >= output_size) {
+            break;  /* this character completes a byte there is no room for */
+        }
+        buffer = (buffer << 6) | (uint32_t)value;
         bits_collected += 6;
         if (bits_collected >= 8) {
-            if (output_idx >= output_size) {
-                return -1;  /* output buffer too small */
-            }
             output[output_idx++] = (uint8_t)((buffer >> (bits_collected - 8)) & 0xFF);
             bits_collected -= 8;
         }
     }
-    return (int)output_idx;
+    cursor->in = i;
+    cursor->out = output_idx;
+    cursor->bits = buffer;
+    cursor->bit_count = bits_collected;
+    return 0;
 }
 
-int encode_base64(const uint8_t *input, size_t input_size, char *output, size_t output_size) {
-    size_t output_idx = 0;
-    size_t i;
-    for (i = 0; i < input_size; i += 3) {
-        if (output_idx + 4 >= output_size) {
-            return -1;  /* output buffer too small */
+void base64_decoder_init(base64_decoder_t *decoder) {
+    memset(decoder, 0, sizeof(base64_decoder_t));
+}
+
+int base64_decoder_update(base64_decoder_t *decoder, const char *input, size_t input_len,
+                          uint8_t *output, size_t output_size, size_t *consumed,
+                          size_t *produced) {
+    base64_cursor_t cursor = {0, 0, decoder->bits, decoder->bit_count};
+
+    *consumed = 0;
+    *produced = 0;
+    if (decoder->padded) {
+        cursor.in = input_len;
+    } else {
+        switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+            case CPU_AVX2:
+                base64_decode_avx2(input, input_len, output, output_size, &cursor);
+                break;
+            case CPU_SSSE3:
+                base64_decode_ssse3(input, input_len, output, output_size, &cursor);
+                break;
+#endif
+            default:
+                break;
+        }
+        if (decode_base64_scalar(input, input_len, output, output_size, &cursor,
+                                 &decoder->padded) < 0) {
+            return -1;
+        }
+    }
+    decoder->bits = cursor.bits;
+    decoder->bit_count = cursor.bit_count;
+    decoder->consumed += cursor.in;
+    decoder->produced += cursor.out;
+    *consumed = cursor.in;
+    *produced = cursor.out;
+    return 0;
+}
+
+int base64_decoder_final(base64_decoder_t *decoder, uint8_t *output, size_t output_size,
+                         size_t *produced) {
+    (void)output;
+    (void)output_size;
+    /* bits short of a byte are dropped, like the unpadded tail of a whole-buffer decode */
+    decoder->bits = 0;
+    decoder->bit_count = 0;
+    *produced = 0;
+    return 0;
+}
+
+int decode_base64(const char *base64, uint8_t *output, size_t output_size) {
+    size_t decoded;
+
+    if (decode_base64_len(base64, strlen(base64), output, output_size, &decoded) < 0 ||
+        decoded > INT_MAX) {
+        return -1;
+    }
+    return (int)decoded;
+}
+
+int decode_base64_len(const char *base64, size_t base64_len, uint8_t *output,
+                      size_t output_size, size_t *decoded) {
+    base64_decoder_t decoder;
+    size_t consumed;
+    size_t produced;
+
+    base64_decoder_init(&decoder);
+    if (base64_decoder_update(&decoder, base64, base64_len, output, output_size, &consumed,
+                              &produced) < 0) {
+        return -1;
+    }
+    if (consumed < base64_len) {
+        return -1;  /* output buffer too small */
+    }
+    *decoded = produced;
+    return 0;
+}
+
+/* characters per slice of a parallel decode, before moving to a quantum boundary */
+#define DECODE_SLICE (4 * WORKERS_SLICE_SIZE)
+
+/*
+ * a whole text split into slices that each start on a quantum boundary (an
+ * even digit count for hex, a multiple of 4 characters for base64), so
+ * each one decodes on its own straight to its place in the output.
+ */
+typedef struct {
+    const char *text;
+    size_t text_len;
+    uint8_t *output;
+    size_t output_size;
+    int base64;
+    size_t slices;
+    size_t *blanks;     /* first pass: characters <= ' ' in each nominal slice */
+    size_t *padding;    /* first pass: first '=' of each nominal slice, text_len if none */
+    size_t *starts;     /* slice k is text[starts[k], starts[k + 1]) */
+    size_t *offsets;    /* and decodes to output + offsets[k] */
+    size_t last_produced;
+    atomic_int failed;
+} decode_job_t;
+
+static void count_slice(void *arg, size_t index) {
+    decode_job_t *job = (decode_job_t *)arg;
+    size_t start = index * DECODE_SLICE;
+    size_t n = job->text_len - start;
+    const char *text = job->text + start;
+    size_t blanks = 0;
+
+    if (n > DECODE_SLICE) {
+        n = DECODE_SLICE;
+    }
+    /* whitespace is all <= ' ', any other such character fails the decode anyway */
+    for (size_t i = 0; i < n; i++) {
+        blanks += (unsigned char)text[i] <= ' ';
+    }
+    job->blanks[index] = blanks;
+    if (job->base64) {
+        const char *pad = memchr(text, '=', n);
+        job->padding[index] = pad ? (size_t)(pad - job->text) : job->text_len;
+    }
+}
+
+static void decode_slice(void *arg, size_t index) {
+    decode_job_t *job = (decode_job_t *)arg;
+    const char *input = job->text + job->starts[index];
+    size_t input_len = job->starts[index + 1] - job->starts[index];
+    int last = index + 1 == job->slices;
+    uint8_t *output = job->output + job->offsets[index];
+    /* a slice before the last fills its room exactly */
+    size_t room = last ? job->output_size - job->offsets[index]
+                       : job->offsets[index + 1] - job->offsets[index];
+    size_t consumed;
+    size_t produced;
+    size_t tail = 0;
+    int result;
+
+    if (job->base64) {
+        base64_decoder_t decoder;
+        base64_decoder_init(&decoder);
+        result = base64_decoder_update(&decoder, input, input_len, output, room, &consumed,
+                                       &produced);
+    } else {
+        hex_decoder_t decoder;
+        hex_decoder_init(&decoder);
+        result = hex_decoder_update(&decoder, input, input_len, output, room, &consumed,
+                                    &produced);
+        if (result == 0 && last) {
+            result = hex_decoder_final(&decoder, output + produced, room - produced, &tail);
         }
-        uint32_t buffer = 0;
-        int bytes_to_process = (input_size - i < 3) ? (int)(input_size - i) : 3;
+    }
+    if (result < 0 || (!last && produced != room)) {
+        atomic_store(&job->failed, 1);
+    }
+    if (last) {
+        job->last_produced = produced + tail;
+    }
+}
 
-        /* build 24-bit buffer */
-        for (int j = 0; j < bytes_to_process; j++) {
-            buffer = (buffer << 8) | input[i + j];
+/*
+ * place the slice boundaries: from each nominal boundary, move forward to
+ * the next quantum boundary. returns -1 when a slice has too few
+ * significant characters to do so, the text is then decoded in one piece.
+ */
+static int place_slices(decode_job_t *job, size_t quantum, size_t quantum_bytes) {
+    size_t blanks = 0;
+
+    job->starts[0] = 0;
+    job->offsets[0] = 0;
+    for (size_t k = 1; k < job->slices; k++) {
+        size_t pos = k * DECODE_SLICE;
+        size_t end = pos + DECODE_SLICE;
+
+        blanks += job->blanks[k - 1];
+        size_t significant = pos - blanks;
+        while (significant % quantum != 0 && pos < end && pos < job->text_len) {
+            significant += (unsigned char)job->text[pos] > ' ';
+            pos++;
         }
+        if (significant % quantum != 0) {
+            return -1;
+        }
+        job->starts[k] = pos;
+        job->offsets[k] = significant / quantum * quantum_bytes;
+    }
+    job->starts[job->slices] = job->text_len;
+    return job->offsets[job->slices - 1] <= job->output_size ? 0 : -1;
+}
+
+/* decode a whole text, one slice per worker when it is large enough */
+static int decode_all(int base64, const char *text, size_t text_len, uint8_t *output,
+                      size_t output_size, size_t *decoded) {
+    decode_job_t job;
+    size_t slices = (text_len + DECODE_SLICE - 1) / DECODE_SLICE;
+    size_t *memory = NULL;
 
-        /* encode to base64 */
-        int bits = bytes_to_process * 8;
-        int chars_to_write = (bits + 5) / 6;
+    memset(&job, 0, sizeof(job));
+    job.text = text;
+    job.text_len = text_len;
+    job.output = output;
+    job.output_size = output_size;
+    job.base64 = base64;
+    atomic_init(&job.failed, 0);
 
-        for (int j = 0; j < chars_to_write; j++) {
-            int shift = (3 - j) * 6;
-            int index = (buffer >> shift) & 0x3F;
-            output[output_idx++] = base64_table[index];
+    if (text_len >= WORKERS_MIN_PARALLEL && workers_count() > 1 && slices > 1) {
+        memory = (size_t *)malloc((4 * slices + 2) * sizeof(size_t));
+    }
+    if (memory) {
+        job.slices = slices;
+        job.blanks = memory;
+        job.padding = memory + slices;
+        job.starts = memory + 2 * slices;
+        job.offsets = memory + 3 * slices + 1;
+        workers_run(slices, count_slice, &job);
+
+        /* nothing after the first '=' is decoded */
+        if (base64) {
+            for (size_t k = 0; k < slices; k++) {
+                if (job.padding[k] < text_len) {
+                    job.text_len = job.padding[k];
+                    job.slices = k + 1;
+                    break;
+                }
+            }
         }
+        if (place_slices(&job, base64 ? 4 : 2, base64 ? 3 : 1) == 0) {
+            workers_run(job.slices, decode_slice, &job);
+            *decoded = job.offsets[job.slices - 1] + job.last_produced;
+            free(memory);
+            return atomic_load(&job.failed) ? -1 : 0;
+        }
+        free(memory);
+    }
+
+    /* small text, one worker or no memory for the slice table: a single slice */
+    size_t bounds[2] = {0, text_len};
+    size_t offset = 0;
+    job.text_len = text_len;
+    job.slices = 1;
+    job.starts = bounds;
+    job.offsets = &offset;
+    decode_slice(&job, 0);
+    *decoded = job.last_produced;
+    return atomic_load(&job.failed) ? -1 : 0;
+}
+
+int decode_hex_all(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                   size_t *decoded) {
+    return decode_all(0, hex, hex_len, output, output_size, decoded);
+}
+
+int decode_base64_all(const char *base64, size_t base64_len, uint8_t *output,
+                      size_t output_size, size_t *decoded) {
+    return decode_all(1, base64, base64_len, output, output_size, decoded);
+}
+
+/* encode a range without the terminator, the output is known to be large enough */
+static size_t encode_base64_range(const uint8_t *input, size_t input_size, char *output) {
+    size_t output_idx = 0;
+    size_t i = 0;
+
+    switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+        case CPU_AVX2:
+            i = base64_encode_avx2(input, input_size, output);
+            break;
+        case CPU_SSSE3:
+            i = base64_encode_ssse3(input, input_size, output);
+            break;
+#endif
+        default:
+            break;
+    }
+    output_idx = (i / 3) * 4;
+    for (; i + 3 <= input_size; i += 3) {
+        uint32_t buffer = ((uint32_t)input[i] << 16) | ((uint32_t)input[i + 1] << 8) | input[i + 2];
+        output[output_idx++] = base64_table[(buffer >> 18) & 0x3F];
+        output[output_idx++] = base64_table[(buffer >> 12) & 0x3F];
+        output[output_idx++] = base64_table[(buffer >> 6) & 0x3F];
+        output[output_idx++] = base64_table[buffer & 0x3F];
+    }
+    if (i < input_size) {
+        /* partial triple, left-aligned so the 6-bit groups line up */
+        uint32_t buffer = (uint32_t)input[i] << 16;
+        if (i + 1 < input_size) {
+            buffer |= (uint32_t)input[i + 1] << 8;
+        }
+        output[output_idx++] = base64_table[(buffer >> 18) & 0x3F];
+        output[output_idx++] = base64_table[(buffer >> 12) & 0x3F];
+        output[output_idx++] = (i + 1 < input_size) ? base64_table[(buffer >> 6) & 0x3F] : '=';
+        output[output_idx++] = '=';
+    }
+    return output_idx;
+}
+
+/* slices are a multiple of 3 bytes, so each one maps to its own 4-character groups */
+static void encode_base64_slice(void *arg, size_t index) {
+    encode_job_t *job = (encode_job_t *)arg;
+    size_t start = index * WORKERS_SLICE_SIZE;
+    size_t n = job->input_size - start;
+    if (n > WORKERS_SLICE_SIZE) {
+        n = WORKERS_SLICE_SIZE;
+    }
+    encode_base64_range(job->input + start, n, job->output + start / 3 * 4);
+}
+
+/* encode without the terminator, across the worker pool when the input is large */
+static void encode_base64_all(const uint8_t *input, size_t input_size, char *output) {
+    if (input_size >= WORKERS_MIN_PARALLEL && workers_count() > 1) {
+        encode_job_t job = {input, input_size, output};
+        workers_run((input_size + WORKERS_SLICE_SIZE - 1) / WORKERS_SLICE_SIZE,
+                    encode_base64_slice, &job);
+    } else {
+        encode_base64_range(input, input_size, output);
+    }
+}
+
+int encode_base64(const uint8_t *input, size_t input_size, char *output, size_t output_size,
+                  size_t *encoded) {
+    size_t encoded_size = ((input_size + 2) / 3) * 4;
+
+    if (input_size > 0 && output_size <= encoded_size) {
+        return -1;  /* output buffer too small */
+    }
+    encode_base64_all(input, input_size, output);
+    output[encoded_size] = '\0';
+    *encoded = encoded_size;
+    return 0;
+}
+
+void base64_encoder_init(base64_encoder_t *encoder) {
+    memset(encoder, 0, sizeof(base64_encoder_t));
+}
 
-        /* add padding if needed */
-        while (chars_to_write < 4) {
-            output[output_idx++] = '=';
-            chars_to_write++;
+int base64_encoder_update(base64_encoder_t *encoder, const uint8_t *input, size_t input_size,
+                          char *output, size_t output_size, size_t *consumed,
+                          size_t *produced) {
+    size_t used = 0;
+    size_t out = 0;
+
+    /* finish the triple left over from the previous call first */
+    if (encoder->tail_len > 0) {
+        while (encoder->tail_len < 3 && used < input_size) {
+            encoder->tail[encoder->tail_len++] = input[used++];
+        }
+        if (encoder->tail_len == 3 && output_size >= 4) {
+            encode_base64_range(encoder->tail, 3, output);
+            encoder->tail_len = 0;
+            out = 4;
+        }
+    }
+    if (encoder->tail_len == 0) {
+        size_t triples = (input_size - used) / 3;
+        if (triples > (output_size - out) / 4) {
+            triples = (output_size - out) / 4;
+        }
+        encode_base64_all(input + used, triples * 3, output + out);
+        used += triples * 3;
+        out += triples * 4;
+        if (input_size - used < 3) {
+            memcpy(encoder->tail, input + used, input_size - used);
+            encoder->tail_len = input_size - used;
+            used = input_size;
         }
     }
-    output[output_idx] = '\0';
-    return (int)output_idx;
+    encoder->consumed += used;
+    encoder->produced += out;
+    *consumed = used;
+    *produced = out;
+    return 0;
 }
 
+int base64_encoder_final(base64_encoder_t *encoder, char *output, size_t output_size,
+                         size_t *produced) {
+    *produced = 0;
+    if (encoder->tail_len == 0) {
+        return 0;
+    }
+    if (output_size < 4) {
+        return -1;
+    }
+    encode_base64_range(encoder->tail, encoder->tail_len, output);
+    encoder->tail_len = 0;
+    encoder->produced += 4;
+    *produced = 4;
+    return 0;
+}
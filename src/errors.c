@@ -0,0 +1,41 @@
+/**
+ * @file errors.c
+ * @brief error messages, printed to stderr or kept for the library api
+ *
+ * both the quiet flag and the last message are per thread, so library
+ * calls on other threads never see or silence each other's errors.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "../include/isenchef.h"
+
+static _Thread_local int quiet_errors;
+static _Thread_local char last_error[256];
+
+void report_error(const char *format, ...) {
+    va_list args;
+    size_t len;
+
+    va_start(args, format);
+    vsnprintf(last_error, sizeof(last_error), format, args);
+    va_end(args);
+    len = strlen(last_error);
+    if (len > 0 && last_error[len - 1] == '\n') {
+        last_error[len - 1] = '\0';
+    }
+    if (!quiet_errors) {
+        fprintf(stderr, "%s\n", last_error);
+    }
+}
+
+int quiet_errors_set(int quiet) {
+    int previous = quiet_errors;
+    quiet_errors = quiet;
+    return previous;
+}
+
+const char *last_error_message(void) {
+    return last_error;
+}
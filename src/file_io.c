@@ -3,172 +3,526 @@
  * @brief file input/output operations
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "../include/isenchef.h"
 #include "../include/encoders.h"
+#include "../include/stats.h"
+#include "../include/buffer_pool.h"
+#include "../include/workers.h"
 
-int read_file(const char *filename, format_t format, buffer_t *buffer) {
-    FILE *file;
-    size_t file_size;
-    char *file_content = NULL;
-    int result = -1;
+/* characters decoded aside before the output can overwrite the input */
+#define IN_PLACE_HEAD 64
+/* smallest tail worth handing back to the allocator after an in-place decode */
+#define IN_PLACE_SHRINK_MIN (1024 * 1024)
 
-    buffer->data = NULL;
-    buffer->size = 0;
+/* pipes are read in steps of this size */
+#define READ_STEP (64 * 1024)
 
-    file = fopen(filename, "rb");
-    if (!file) {
-        perror("opening input file");
+/* largest single write of a whole output */
+#define WRITE_BLOCK (8 * 1024 * 1024)
+/* offset, size and address alignment of O_DIRECT writes */
+#define DIRECT_ALIGN 4096
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define set_binary(file) _setmode(_fileno(file), _O_BINARY)
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#define set_binary(file) ((void)0)
+#endif
+
+int is_stdio_path(const char *filename) {
+    return strcmp(filename, "-") == 0;
+}
+
+FILE *open_input(const char *filename) {
+    if (is_stdio_path(filename)) {
+        set_binary(stdin);
+        return stdin;
+    }
+    return fopen(filename, "rb");
+}
+
+FILE *open_output(const char *filename) {
+    if (is_stdio_path(filename)) {
+        set_binary(stdout);
+        return stdout;
+    }
+    return fopen(filename, "wb");
+}
+
+int output_is_input(FILE *in, const char *output) {
+    if (is_stdio_path(output)) {
+        return 0;
+    }
+#ifdef _WIN32
+    /* no inode numbers to compare */
+    (void)in;
+    return 0;
+#else
+    struct stat in_st;
+    struct stat out_st;
+    return fstat(fileno(in), &in_st) == 0 && stat(output, &out_st) == 0 &&
+           in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino;
+#endif
+}
+
+int close_file(FILE *file) {
+    if (file == stdin) {
+        return 0;
+    }
+    if (file == stdout) {
+        return fflush(stdout);
+    }
+    return fclose(file);
+}
+
+/* make a scratch buffer hold at least size bytes, its old content is dropped */
+static void *reserve(void *buffer, size_t *capacity, size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (buffer && *capacity >= size) {
+        return buffer;
+    }
+    pool_free(buffer, *capacity);
+    return pool_alloc(size, capacity);
+}
+
+char *scratch_text(io_scratch_t *scratch, size_t size) {
+    scratch->text = (char *)reserve(scratch->text, &scratch->text_size, size + 1);
+    return scratch->text;
+}
+
+/*
+ * decode text over itself, the output is never longer than the input. the
+ * kernels store whole vectors past the bytes they produce, so the first
+ * characters go through a small side buffer until the write position
+ * trails the read position by more than a vector. the gap only grows after
+ * that.
+ */
+static int decode_in_place(format_t format, char *text, size_t text_len, size_t *decoded) {
+    uint8_t head[IN_PLACE_HEAD];
+    uint8_t *output = (uint8_t *)text;
+    size_t head_len = (text_len < IN_PLACE_HEAD) ? text_len : IN_PLACE_HEAD;
+    size_t head_consumed, head_produced;
+    size_t consumed, produced, tail;
+    int result;
+
+    if (format == FORMAT_HEX) {
+        hex_decoder_t decoder;
+        hex_decoder_init(&decoder);
+        result = hex_decoder_update(&decoder, text, head_len, head, sizeof(head), &head_consumed,
+                                    &head_produced);
+        if (result == 0) {
+            result = hex_decoder_update(&decoder, text + head_consumed, text_len - head_consumed,
+                                        output + head_produced, text_len - head_produced,
+                                        &consumed, &produced);
+        }
+        if (result == 0) {
+            result = hex_decoder_final(&decoder, output + head_produced + produced,
+                                       text_len + 1 - head_produced - produced, &tail);
+        }
+    } else {
+        base64_decoder_t decoder;
+        base64_decoder_init(&decoder);
+        result = base64_decoder_update(&decoder, text, head_len, head, sizeof(head),
+                                       &head_consumed, &head_produced);
+        if (result == 0) {
+            result = base64_decoder_update(&decoder, text + head_consumed,
+                                           text_len - head_consumed, output + head_produced,
+                                           text_len - head_produced, &consumed, &produced);
+        }
+        if (result == 0) {
+            result = base64_decoder_final(&decoder, output + head_produced + produced,
+                                          text_len + 1 - head_produced - produced, &tail);
+        }
+    }
+    if (result < 0 || head_consumed + consumed != text_len) {
         return -1;
     }
+    memcpy(output, head, head_produced);
+    *decoded = head_produced + produced + tail;
+    return 0;
+}
 
-    /* get file size */
-    fseek(file, 0, SEEK_END);
-    file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+int decode_scratch(format_t format, size_t text_len, buffer_t *buffer, io_scratch_t *scratch) {
+    char *text = scratch->text;
+    size_t decoded;
 
+    buffer->data = NULL;
+    buffer->size = 0;
+    text[text_len] = '\0';
     if (format == FORMAT_BYTES) {
-        buffer->data = (uint8_t *)malloc(file_size);
-        if (!buffer->data) {
-            fprintf(stderr, "memory allocation failed\n");
-            fclose(file);
+        buffer->data = (uint8_t *)text;
+        buffer->size = text_len;
+        return 0;
+    }
+
+    /* decoding has always stopped at the first nul */
+    char *nul = memchr(text, '\0', text_len);
+    if (nul) {
+        text_len = (size_t)(nul - text);
+    }
+
+    /*
+     * with several workers a large text is decoded into scratch->data
+     * instead, each worker writing its own slice of it. in place, every
+     * slice but the first would have to be moved down afterwards.
+     */
+    if (text_len >= WORKERS_MIN_PARALLEL && workers_count() > 1) {
+        size_t bound = (format == FORMAT_HEX) ? (text_len + 1) / 2 : text_len / 4 * 3 + 3;
+        void *data = reserve(scratch->data, &scratch->data_size, bound);
+        scratch->data = (uint8_t *)data;
+        if (!data) {
             return -1;
         }
-        buffer->size = fread(buffer->data, 1, file_size, file);
-        if (buffer->size != file_size) {
-            fprintf(stderr, "failed to read entire file\n");
-            free(buffer->data);
-            buffer->data = NULL;
-            fclose(file);
+        STATS_BEGIN(parallel_mark);
+        int result = (format == FORMAT_HEX)
+                         ? decode_hex_all(text, text_len, scratch->data, bound, &decoded)
+                         : decode_base64_all(text, text_len, scratch->data, bound, &decoded);
+        if (result < 0) {
+            fprintf(stderr, "invalid %s format\n", (format == FORMAT_HEX) ? "hex" : "base64");
             return -1;
         }
-        result = 0;
-    } else {
-        /* need to decode hex or base64 */
-        file_content = (char *)malloc(file_size + 1);
-        if (!file_content) {
-            fprintf(stderr, "memory allocation failed\n");
-            fclose(file);
+        STATS_END(STATS_DECODE, parallel_mark, text_len, decoded);
+
+        /* the text is no longer needed, keep its address range for the next job */
+        pool_shrink(text, scratch->text_size, 0);
+        buffer->data = scratch->data;
+        buffer->size = decoded;
+        return 0;
+    }
+
+    STATS_BEGIN(decode_mark);
+    if (decode_in_place(format, text, text_len, &decoded) < 0) {
+        fprintf(stderr, "invalid %s format\n", (format == FORMAT_HEX) ? "hex" : "base64");
+        return -1;
+    }
+    STATS_END(STATS_DECODE, decode_mark, text_len, decoded);
+
+    /* give the pages of a large unused tail back, the buffer keeps its size for the next job */
+    if (scratch->text_size - decoded >= IN_PLACE_SHRINK_MIN) {
+        pool_shrink(text, scratch->text_size, decoded + 1);
+    }
+    buffer->data = (uint8_t *)scratch->text;
+    buffer->size = decoded;
+    return 0;
+}
+
+/*
+ * read a whole file into a scratch buffer with one byte spare for a
+ * terminator. pipes and terminals have no size, the buffer grows until
+ * they end.
+ */
+static int read_all(FILE *file, void **buffer, size_t *capacity, size_t *length) {
+    long start = ftell(file);
+    long end = -1;
+
+    if (start >= 0 && fseek(file, 0, SEEK_END) == 0) {
+        end = ftell(file);
+        fseek(file, start, SEEK_SET);
+    }
+    if (end >= start && start >= 0) {
+        size_t size = (size_t)(end - start);
+        *buffer = reserve(*buffer, capacity, size + 1);
+        if (!*buffer) {
             return -1;
         }
-        size_t read_size = fread(file_content, 1, file_size, file);
-        file_content[read_size] = '\0';
-
-        /* estimate output size, but idk if it's really optimal */
-        size_t max_output_size = (format == FORMAT_HEX) ? (file_size / 2 + 1) : 
-                                                          ((file_size * 3) / 4 + 1);
-        buffer->data = (uint8_t *)malloc(max_output_size);
-        if (!buffer->data) {
-            fprintf(stderr, "memory allocation failed\n");
-            free(file_content);
-            fclose(file);
+        *length = fread(*buffer, 1, size, file);
+        if (*length != size) {
+            fprintf(stderr, "failed to read entire file\n");
             return -1;
         }
+        return 0;
+    }
 
-        if (format == FORMAT_HEX) {
-            int decoded_size = decode_hex(file_content, buffer->data, max_output_size);
-            if (decoded_size < 0) {
-                fprintf(stderr, "invalid hex format\n");
-                free(buffer->data);
-                buffer->data = NULL;
-                result = -1;
-            } else {
-                buffer->size = (size_t)decoded_size;
-                result = 0;
-            }
-        } else if (format == FORMAT_BASE64) {
-            int decoded_size = decode_base64(file_content, buffer->data, max_output_size);
-            if (decoded_size < 0) {
-                fprintf(stderr, "invalid base64 format\n");
-                free(buffer->data);
-                buffer->data = NULL;
-                result = -1;
-            } else {
-                buffer->size = (size_t)decoded_size;
-                result = 0;
+    *length = 0;
+    for (;;) {
+        if (!*buffer || *capacity - *length < READ_STEP + 1) {
+            size_t grown = (*capacity > READ_STEP) ? *capacity * 2 : READ_STEP * 2;
+            void *bigger = pool_grow(*buffer, capacity, *length, grown);
+            if (!bigger) {
+                return -1;
             }
+            *buffer = bigger;
+        }
+        size_t n = fread((char *)*buffer + *length, 1, *capacity - *length - 1, file);
+        *length += n;
+        if (n == 0) {
+            break;
         }
-        free(file_content);
     }
-    fclose(file);
-    return result;
+    if (ferror(file)) {
+        perror("reading input file");
+        return -1;
+    }
+    return 0;
 }
 
-int write_file(const char *filename, format_t format, const buffer_t *buffer) {
+int read_file_scratch(const char *filename, format_t format, buffer_t *buffer,
+                      io_scratch_t *scratch) {
     FILE *file;
-    int result = -1;
+    void *data;
+    size_t length;
+    int result;
 
-    file = fopen(filename, "wb");
+    buffer->data = NULL;
+    buffer->size = 0;
+
+    file = open_input(filename);
     if (!file) {
-        perror("opening output file");
+        perror("opening input file");
         return -1;
     }
 
+    STATS_BEGIN(read_mark);
     if (format == FORMAT_BYTES) {
-        size_t written = fwrite(buffer->data, 1, buffer->size, file);
-        if (written != buffer->size) {
-            fprintf(stderr, "failed to write entire file\n");
-            fclose(file);
+        data = scratch->data;
+        result = read_all(file, &data, &scratch->data_size, &length);
+        scratch->data = (uint8_t *)data;
+    } else {
+        data = scratch->text;
+        result = read_all(file, &data, &scratch->text_size, &length);
+        scratch->text = (char *)data;
+    }
+    STATS_END(STATS_READ, read_mark, length, length);
+    close_file(file);
+    if (result < 0) {
+        return -1;
+    }
+
+    if (format == FORMAT_BYTES) {
+        buffer->data = scratch->data;
+        buffer->size = length;
+        return 0;
+    }
+    /* need to decode hex or base64 */
+    return decode_scratch(format, length, buffer, scratch);
+}
+
+int read_file(const char *filename, format_t format, buffer_t *buffer) {
+    io_scratch_t scratch = {0};
+
+    int result = read_file_scratch(filename, format, buffer, &scratch);
+    if (result == 0) {
+        /* the caller owns the data from here, free_buffer releases it */
+        if (buffer->data == (uint8_t *)scratch.text) {
+            buffer->capacity = scratch.text_size;
+            scratch.text = NULL;
+        } else {
+            buffer->capacity = scratch.data_size;
+            scratch.data = NULL;
+        }
+    }
+    free_scratch(&scratch);
+    return result;
+}
+
+int encode_scratch(format_t format, const buffer_t *buffer, io_scratch_t *scratch,
+                   const void **output, size_t *output_size) {
+    if (format == FORMAT_BYTES) {
+        *output = buffer->data;
+        *output_size = buffer->size;
+        return 0;
+    }
+
+    /* encode to hex or base64 */
+    size_t encoded_size = (format == FORMAT_HEX) ? buffer->size * 2 + 1
+                                                 : ((buffer->size + 2) / 3) * 4 + 1;
+    char *encoded = (char *)reserve(scratch->encoded, &scratch->encoded_size, encoded_size);
+    scratch->encoded = encoded;
+    if (!encoded) {
+        return -1;
+    }
+    STATS_BEGIN(encode_mark);
+    if (format == FORMAT_HEX) {
+        if (encode_hex(buffer->data, buffer->size, encoded) < 0) {
+            fprintf(stderr, "hex encoding failed\n");
             return -1;
         }
-        result = 0;
+        *output_size = buffer->size * 2;
     } else {
-        /* encode to hex or base64 */
-        size_t output_size;
-        char *output = NULL;
-
-        if (format == FORMAT_HEX) {
-            output_size = buffer->size * 2 + 1;
-            output = (char *)malloc(output_size);
-            if (!output) {
-                fprintf(stderr, "memory allocation failed\n");
-                fclose(file);
-                return -1;
-            }
-            if (encode_hex(buffer->data, buffer->size, output) < 0) {
-                fprintf(stderr, "hex encoding failed\n");
-                free(output);
-                fclose(file);
-                return -1;
-            }
-        } else if (format == FORMAT_BASE64) {
-            output_size = ((buffer->size + 2) / 3) * 4 + 1;
-            output = (char *)malloc(output_size);
-            if (!output) {
-                fprintf(stderr, "memory allocation failed\n");
-                fclose(file);
-                return -1;
-            }
-            int encoded_size = encode_base64(buffer->data, buffer->size, output, output_size);
-            if (encoded_size < 0) {
-                fprintf(stderr, "base64 encoding failed\n");
-                free(output);
-                fclose(file);
-                return -1;
+        if (encode_base64(buffer->data, buffer->size, encoded, encoded_size, output_size) < 0) {
+            fprintf(stderr, "base64 encoding failed\n");
+            return -1;
+        }
+    }
+    STATS_END(STATS_ENCODE, encode_mark, buffer->size, *output_size);
+    *output = encoded;
+    return 0;
+}
+
+#ifndef _WIN32
+
+static int write_blocks(int fd, const uint8_t *data, size_t size) {
+    size_t done = 0;
+
+    while (done < size) {
+        size_t n = (size - done < WRITE_BLOCK) ? size - done : WRITE_BLOCK;
+        ssize_t written = write(fd, data + done, n);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            output_size = encoded_size;
+            perror("writing output file");
+            return -1;
         }
-        size_t written = fwrite(output, 1, output_size - 1, file);
-        if (written != output_size - 1) {
-            fprintf(stderr, "failed to write entire file\n");
-            free(output);
-            fclose(file);
+        done += (size_t)written;
+    }
+    return 0;
+}
+
+/* O_DIRECT wants aligned memory and lengths, the data goes through an aligned block */
+static int write_direct(int fd, const uint8_t *data, size_t size) {
+    size_t capacity;
+    size_t done = 0;
+    int result = 0;
+
+    /* pool buffers start on a page, which covers DIRECT_ALIGN */
+    void *block = pool_alloc(WRITE_BLOCK, &capacity);
+    if (!block) {
+        return -1;
+    }
+    while (done < size && result == 0) {
+        size_t n = (size - done < WRITE_BLOCK) ? size - done : WRITE_BLOCK;
+        size_t padded = (n + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+        memcpy(block, data + done, n);
+        memset((uint8_t *)block + n, 0, padded - n);
+        result = write_blocks(fd, (const uint8_t *)block, padded);
+        done += n;
+    }
+    pool_free(block, capacity);
+    /* the last block was padded up to the alignment */
+    if (result == 0 && size % DIRECT_ALIGN != 0 && ftruncate(fd, (off_t)size) < 0) {
+        perror("sizing output file");
+        result = -1;
+    }
+    return result;
+}
+
+/*
+ * write an output whose size is known. the file gets its whole size in
+ * one go before the data arrives, so the file system can lay it out in
+ * few extents. direct bypasses the page cache, or where the file system
+ * refuses O_DIRECT, drops the written pages from it afterwards.
+ */
+static int write_output_fd(const char *filename, const void *output, size_t size, int direct) {
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    int opened_direct = 0;
+    int result;
+    int fd = -1;
+
+#ifdef O_DIRECT
+    if (direct) {
+        fd = open(filename, flags | O_DIRECT, 0666);
+        opened_direct = fd >= 0;
+    }
+#endif
+    if (fd < 0) {
+        fd = open(filename, flags, 0666);
+    }
+    if (fd < 0) {
+        perror("opening output file");
+        return -1;
+    }
+#ifdef __linux__
+    /* not every file system can, the writes then allocate as they go */
+    if (size > 0) {
+        fallocate(fd, 0, 0, (off_t)size);
+    }
+#endif
+
+    if (opened_direct) {
+        result = write_direct(fd, (const uint8_t *)output, size);
+    } else {
+        result = write_blocks(fd, (const uint8_t *)output, size);
+    }
+#ifdef POSIX_FADV_DONTNEED
+    if (result == 0 && direct && !opened_direct) {
+        /* only clean pages can be dropped */
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+    if (close(fd) < 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    return result;
+}
+
+#endif
+
+int write_file_scratch(const char *filename, format_t format, const buffer_t *buffer,
+                       io_scratch_t *scratch, int direct) {
+    FILE *file;
+    const void *output;
+    size_t output_size;
+
+    if (encode_scratch(format, buffer, scratch, &output, &output_size) < 0) {
+        return -1;
+    }
+    STATS_BEGIN(write_mark);
+#ifndef _WIN32
+    if (!is_stdio_path(filename)) {
+        if (write_output_fd(filename, output, output_size, direct) < 0) {
             return -1;
         }
-        free(output);
-        result = 0;
+        STATS_END(STATS_WRITE, write_mark, output_size, output_size);
+        return 0;
+    }
+#else
+    (void)direct;
+#endif
+    file = open_output(filename);
+    if (!file) {
+        perror("opening output file");
+        return -1;
     }
-    fclose(file);
+    size_t written = fwrite(output, 1, output_size, file);
+    if (close_file(file) != 0 || written != output_size) {
+        fprintf(stderr, "failed to write entire file\n");
+        return -1;
+    }
+    STATS_END(STATS_WRITE, write_mark, output_size, output_size);
+    return 0;
+}
+
+int write_file(const char *filename, format_t format, const buffer_t *buffer) {
+    io_scratch_t scratch = {0};
+
+    int result = write_file_scratch(filename, format, buffer, &scratch, 0);
+    free_scratch(&scratch);
     return result;
 }
 
 void free_buffer(buffer_t *buffer) {
     if (buffer->data) {
-        free(buffer->data);
+        if (buffer->capacity) {
+            pool_free(buffer->data, buffer->capacity);
+        } else {
+            free(buffer->data);
+        }
         buffer->data = NULL;
     }
     buffer->size = 0;
+    buffer->capacity = 0;
 }
 
+void free_scratch(io_scratch_t *scratch) {
+    pool_free(scratch->text, scratch->text_size);
+    pool_free(scratch->data, scratch->data_size);
+    pool_free(scratch->encoded, scratch->encoded_size);
+    memset(scratch, 0, sizeof(io_scratch_t));
+}
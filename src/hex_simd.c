@@ -0,0 +1,247 @@
+/**
+ * @file hex_simd.c
+ * @brief sse2/ssse3/avx2 hex encode and decode kernels
+ */
+
+#include "../include/simd.h"
+
+#ifdef ISENCHEF_X86
+
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+uint8_t simd_pack_table[256][8];
+
+__attribute__((constructor)) static void build_pack_table(void) {
+    for (int mask = 0; mask < 256; mask++) {
+        int n = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (mask & (1 << bit)) {
+                simd_pack_table[mask][n++] = (uint8_t)bit;
+            }
+        }
+        while (n < 8) {
+            simd_pack_table[mask][n++] = 0x80;
+        }
+    }
+}
+
+/* per-character classification of 16 hex characters */
+typedef struct {
+    __m128i nibble;  /* value of each hex digit, garbage elsewhere */
+    unsigned ws;     /* bit set for whitespace */
+    unsigned bad;    /* bit set for anything else that is not a hex digit */
+} hex_class_t;
+
+SSE2 static inline hex_class_t classify16(__m128i v) {
+    hex_class_t c;
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    /* isspace in the C locale: ' ' and '\t'..'\r' */
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                              _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                            _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1))));
+
+    c.nibble = _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+        _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    c.ws = (unsigned)_mm_movemask_epi8(ws);
+    c.bad = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, alpha), ws)) ^ 0xFFFF;
+    return c;
+}
+
+/* join 16 nibbles into 8 bytes, even positions are the high nibbles */
+SSE2 static inline __m128i join_nibbles_sse2(__m128i nibble) {
+    __m128i high = _mm_slli_epi16(_mm_and_si128(nibble, _mm_set1_epi16(0x00FF)), 4);
+    __m128i low = _mm_srli_epi16(nibble, 8);
+    return _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128());
+}
+
+SSSE3 static inline __m128i join_nibbles_ssse3(__m128i nibble) {
+    __m128i pairs = _mm_maddubs_epi16(nibble, _mm_set1_epi16(0x0110));
+    return _mm_packus_epi16(pairs, _mm_setzero_si128());
+}
+
+/* pair up the digits of a block with whitespace one character at a time */
+SSE2 static void pack_block_sse2(__m128i nibble, unsigned ws, uint8_t *output,
+                                 hex_cursor_t *cursor) {
+    uint8_t values[16];
+
+    _mm_storeu_si128((__m128i *)values, nibble);
+    for (int i = 0; i < 16; i++) {
+        if (ws & (1u << i)) {
+            continue;
+        }
+        if (cursor->high < 0) {
+            cursor->high = values[i];
+        } else {
+            output[cursor->out++] = (uint8_t)((cursor->high << 4) | values[i]);
+            cursor->high = -1;
+        }
+    }
+}
+
+/* drop the whitespace with pshufb, then pair up what is left */
+SSSE3 static void pack_block_ssse3(__m128i nibble, unsigned ws, uint8_t *output,
+                                   hex_cursor_t *cursor) {
+    uint8_t stage[48];
+    unsigned keep = ~ws & 0xFFFF;
+    unsigned low_keep = keep & 0xFF;
+    unsigned high_keep = keep >> 8;
+    size_t n = 0;
+
+    if (cursor->high >= 0) {
+        stage[n++] = (uint8_t)cursor->high;
+    }
+    __m128i low = _mm_shuffle_epi8(nibble,
+                                   _mm_loadl_epi64((const __m128i *)simd_pack_table[low_keep]));
+    _mm_storel_epi64((__m128i *)(stage + n), low);
+    n += (size_t)__builtin_popcount(low_keep);
+    __m128i high = _mm_shuffle_epi8(_mm_srli_si128(nibble, 8),
+                                    _mm_loadl_epi64((const __m128i *)simd_pack_table[high_keep]));
+    _mm_storel_epi64((__m128i *)(stage + n), high);
+    n += (size_t)__builtin_popcount(high_keep);
+
+    __m128i joined = join_nibbles_ssse3(_mm_loadu_si128((const __m128i *)stage));
+    _mm_storel_epi64((__m128i *)(output + cursor->out), joined);
+    cursor->out += n / 2;
+    cursor->high = (n & 1) ? stage[n - 1] : -1;
+}
+
+SSE2 int hex_decode_sse2(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                         hex_cursor_t *cursor) {
+    /* a block yields at most 8 bytes, keep one spare so the scalar limit never hits mid-block */
+    while (cursor->in + 16 <= hex_len && output_size - cursor->out > 8) {
+        hex_class_t c = classify16(_mm_loadu_si128((const __m128i *)(hex + cursor->in)));
+        if (c.bad) {
+            return -1;
+        }
+        if (c.ws == 0 && cursor->high < 0) {
+            _mm_storel_epi64((__m128i *)(output + cursor->out), join_nibbles_sse2(c.nibble));
+            cursor->out += 8;
+        } else {
+            pack_block_sse2(c.nibble, c.ws, output, cursor);
+        }
+        cursor->in += 16;
+    }
+    return 0;
+}
+
+SSSE3 int hex_decode_ssse3(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                           hex_cursor_t *cursor) {
+    while (cursor->in + 16 <= hex_len && output_size - cursor->out > 8) {
+        hex_class_t c = classify16(_mm_loadu_si128((const __m128i *)(hex + cursor->in)));
+        if (c.bad) {
+            return -1;
+        }
+        if (c.ws == 0 && cursor->high < 0) {
+            _mm_storel_epi64((__m128i *)(output + cursor->out), join_nibbles_ssse3(c.nibble));
+            cursor->out += 8;
+        } else {
+            pack_block_ssse3(c.nibble, c.ws, output, cursor);
+        }
+        cursor->in += 16;
+    }
+    return 0;
+}
+
+AVX2 int hex_decode_avx2(const char *hex, size_t hex_len, uint8_t *output, size_t output_size,
+                         hex_cursor_t *cursor) {
+    while (cursor->in + 32 <= hex_len && output_size - cursor->out > 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(hex + cursor->in));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+        __m256i valid = _mm256_or_si256(digit, alpha);
+
+        if ((unsigned)_mm256_movemask_epi8(valid) == 0xFFFFFFFFu && cursor->high < 0) {
+            __m256i nibble = _mm256_or_si256(
+                _mm256_and_si256(digit, _mm256_sub_epi8(v, _mm256_set1_epi8('0'))),
+                _mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+            __m256i pairs = _mm256_maddubs_epi16(nibble, _mm256_set1_epi16(0x0110));
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, pairs), 0x08);
+            _mm_storeu_si128((__m128i *)(output + cursor->out), _mm256_castsi256_si128(packed));
+            cursor->out += 16;
+        } else {
+            /* whitespace or an odd digit carried over: take the two halves separately */
+            hex_class_t low = classify16(_mm256_castsi256_si128(v));
+            hex_class_t high = classify16(_mm256_extracti128_si256(v, 1));
+            if (low.bad || high.bad) {
+                return -1;
+            }
+            pack_block_ssse3(low.nibble, low.ws, output, cursor);
+            pack_block_ssse3(high.nibble, high.ws, output, cursor);
+        }
+        cursor->in += 32;
+    }
+    return 0;
+}
+
+/* hex character of each nibble, '0' + n plus the gap up to 'a' when n > 9 */
+SSE2 static inline __m128i hex_chars_sse2(__m128i nibble) {
+    __m128i gap = _mm_and_si128(_mm_cmpgt_epi8(nibble, _mm_set1_epi8(9)),
+                                _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibble, _mm_set1_epi8('0')), gap);
+}
+
+SSE2 size_t hex_encode_sse2(const uint8_t *input, size_t input_size, char *output) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+
+    for (; i + 16 <= input_size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i high = hex_chars_sse2(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i low = hex_chars_sse2(_mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)(output + i * 2), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i *)(output + i * 2 + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+
+SSSE3 size_t hex_encode_ssse3(const uint8_t *input, size_t input_size, char *output) {
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a',
+                                         'b', 'c', 'd', 'e', 'f');
+    size_t i = 0;
+
+    for (; i + 16 <= input_size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(input + i));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)(output + i * 2), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i *)(output + i * 2 + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+
+AVX2 size_t hex_encode_avx2(const uint8_t *input, size_t input_size, char *output) {
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i digits = _mm256_setr_epi8(
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    size_t i = 0;
+
+    for (; i + 32 <= input_size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(input + i));
+        __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, mask));
+        /* unpack works per 128-bit lane, put the lanes back in order */
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256((__m256i *)(output + i * 2),
+                            _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)(output + i * 2 + 32),
+                            _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+#endif /* ISENCHEF_X86 */
@@ -0,0 +1,321 @@
+/**
+ * @file libisenchef.c
+ * @brief embeddable api on top of the codecs and the pipeline
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libisenchef.h"
+#include "../include/isenchef.h"
+#include "../include/encoders.h"
+#include "../include/pipeline.h"
+
+/* decoded bytes per round of isenchef_ctx_transform */
+#define CTX_BLOCK_SIZE (48 * 1024)
+
+_Static_assert((int)ISENCHEF_HEX == (int)FORMAT_HEX && (int)ISENCHEF_BASE64 == (int)FORMAT_BASE64,
+               "public formats must match format_t");
+
+struct isenchef_ctx {
+    config_t config;    /* owns the recipe text the stages point into */
+    pipeline_t pipeline;
+    hex_decoder_t hex_in;
+    base64_decoder_t base64_in;
+    hex_encoder_t hex_out;
+    base64_encoder_t base64_out;
+    uint8_t block[CTX_BLOCK_SIZE];
+};
+
+size_t isenchef_encoded_size(isenchef_format_t format, size_t size) {
+    if (format == ISENCHEF_BYTES) {
+        return size;
+    }
+    if (format == ISENCHEF_HEX) {
+        return size * 2 + 1;
+    }
+    return ((size + 2) / 3) * 4 + 1;
+}
+
+size_t isenchef_decoded_size(isenchef_format_t format, size_t length) {
+    switch (format) {
+        case ISENCHEF_HEX:
+            return length / 2 + (length & 1);
+        case ISENCHEF_BASE64:
+            return (length / 4) * 3 + ((length % 4) * 3) / 4;
+        default:
+            return length;
+    }
+}
+
+/* the codec objects of a context, for whichever formats its recipe uses */
+static int ctx_decode(isenchef_ctx_t *ctx, isenchef_format_t format, const char *input,
+                      size_t length, uint8_t *output, size_t output_size, size_t *consumed,
+                      size_t *produced) {
+    if (format == ISENCHEF_HEX) {
+        return hex_decoder_update(&ctx->hex_in, input, length, output, output_size, consumed,
+                                  produced);
+    }
+    return base64_decoder_update(&ctx->base64_in, input, length, output, output_size, consumed,
+                                 produced);
+}
+
+static int ctx_decode_final(isenchef_ctx_t *ctx, isenchef_format_t format, uint8_t *output,
+                            size_t output_size, size_t *produced) {
+    if (format == ISENCHEF_HEX) {
+        return hex_decoder_final(&ctx->hex_in, output, output_size, produced);
+    }
+    return base64_decoder_final(&ctx->base64_in, output, output_size, produced);
+}
+
+static int ctx_encode(isenchef_ctx_t *ctx, isenchef_format_t format, const uint8_t *input,
+                      size_t size, char *output, size_t output_size, size_t *consumed,
+                      size_t *produced) {
+    if (format == ISENCHEF_HEX) {
+        return hex_encoder_update(&ctx->hex_out, input, size, output, output_size, consumed,
+                                  produced);
+    }
+    return base64_encoder_update(&ctx->base64_out, input, size, output, output_size, consumed,
+                                 produced);
+}
+
+static int ctx_encode_final(isenchef_ctx_t *ctx, isenchef_format_t format, char *output,
+                            size_t output_size, size_t *produced) {
+    if (format == ISENCHEF_HEX) {
+        return hex_encoder_final(&ctx->hex_out, output, output_size, produced);
+    }
+    return base64_encoder_final(&ctx->base64_out, output, output_size, produced);
+}
+
+static void ctx_codecs_init(isenchef_ctx_t *ctx) {
+    hex_decoder_init(&ctx->hex_in);
+    base64_decoder_init(&ctx->base64_in);
+    hex_encoder_init(&ctx->hex_out);
+    base64_encoder_init(&ctx->base64_out);
+}
+
+int isenchef_encode(isenchef_format_t format, const uint8_t *input, size_t size, char *output,
+                    size_t output_size, size_t *written) {
+    size_t consumed;
+    size_t produced;
+    size_t tail;
+    int result;
+
+    *written = 0;
+    if (output_size < isenchef_encoded_size(format, size)) {
+        return ISENCHEF_NO_SPACE;
+    }
+    if (format == ISENCHEF_BYTES) {
+        memcpy(output, input, size);
+        *written = size;
+        return ISENCHEF_OK;
+    }
+    if (format == ISENCHEF_HEX) {
+        hex_encoder_t encoder;
+        hex_encoder_init(&encoder);
+        result = hex_encoder_update(&encoder, input, size, output, output_size, &consumed,
+                                    &produced);
+        if (result == 0) {
+            result = hex_encoder_final(&encoder, output + produced, output_size - produced,
+                                       &tail);
+        }
+    } else {
+        base64_encoder_t encoder;
+        base64_encoder_init(&encoder);
+        result = base64_encoder_update(&encoder, input, size, output, output_size, &consumed,
+                                       &produced);
+        if (result == 0) {
+            result = base64_encoder_final(&encoder, output + produced, output_size - produced,
+                                          &tail);
+        }
+    }
+    if (result < 0) {
+        return ISENCHEF_ERROR;
+    }
+    output[produced + tail] = '\0';
+    *written = produced + tail;
+    return ISENCHEF_OK;
+}
+
+int isenchef_decode(isenchef_format_t format, const char *input, size_t length, uint8_t *output,
+                    size_t output_size, size_t *written) {
+    size_t consumed;
+    size_t produced;
+    size_t tail;
+    int result;
+
+    *written = 0;
+    if (output_size < isenchef_decoded_size(format, length)) {
+        return ISENCHEF_NO_SPACE;
+    }
+    if (format == ISENCHEF_BYTES) {
+        memcpy(output, input, length);
+        *written = length;
+        return ISENCHEF_OK;
+    }
+    if (format == ISENCHEF_HEX) {
+        hex_decoder_t decoder;
+        hex_decoder_init(&decoder);
+        result = hex_decoder_update(&decoder, input, length, output, output_size, &consumed,
+                                    &produced);
+        if (result == 0) {
+            result = hex_decoder_final(&decoder, output + produced, output_size - produced,
+                                       &tail);
+        }
+    } else {
+        base64_decoder_t decoder;
+        base64_decoder_init(&decoder);
+        result = base64_decoder_update(&decoder, input, length, output, output_size, &consumed,
+                                       &produced);
+        if (result == 0) {
+            result = base64_decoder_final(&decoder, output + produced, output_size - produced,
+                                          &tail);
+        }
+    }
+    if (result < 0) {
+        return ISENCHEF_ERROR;
+    }
+    *written = produced + tail;
+    return ISENCHEF_OK;
+}
+
+isenchef_ctx_t *isenchef_ctx_new(const char *recipe) {
+    isenchef_ctx_t *ctx = (isenchef_ctx_t *)calloc(1, sizeof(isenchef_ctx_t));
+    int quiet;
+
+    if (!ctx) {
+        quiet = quiet_errors_set(1);
+        report_error("memory allocation failed");
+        quiet_errors_set(quiet);
+        return NULL;
+    }
+    /* the reasons go to isenchef_last_error, not to the embedder's stderr */
+    quiet = quiet_errors_set(1);
+    if ((recipe && *recipe != '\0' && parse_recipe(recipe, &ctx->config) < 0) ||
+        pipeline_init(&ctx->pipeline, ctx->config.steps, ctx->config.step_count) < 0) {
+        quiet_errors_set(quiet);
+        free_config(&ctx->config);
+        free(ctx);
+        return NULL;
+    }
+    quiet_errors_set(quiet);
+    return ctx;
+}
+
+void isenchef_ctx_free(isenchef_ctx_t *ctx) {
+    if (!ctx) {
+        return;
+    }
+    pipeline_free(&ctx->pipeline);
+    free_config(&ctx->config);
+    free(ctx);
+}
+
+const char *isenchef_last_error(void) {
+    return last_error_message();
+}
+
+int isenchef_ctx_reset(isenchef_ctx_t *ctx) {
+    int quiet = quiet_errors_set(1);
+    int result = pipeline_reset(&ctx->pipeline);
+    quiet_errors_set(quiet);
+    return (result < 0) ? ISENCHEF_ERROR : ISENCHEF_OK;
+}
+
+int isenchef_ctx_apply(isenchef_ctx_t *ctx, uint8_t *data, size_t size) {
+    int quiet = quiet_errors_set(1);
+    int result = pipeline_run(&ctx->pipeline, data, size);
+    quiet_errors_set(quiet);
+    return (result < 0) ? ISENCHEF_ERROR : ISENCHEF_OK;
+}
+
+size_t isenchef_ctx_output_size(const isenchef_ctx_t *ctx, size_t size) {
+    size_t decoded = isenchef_decoded_size((isenchef_format_t)ctx->config.input_format, size);
+    return isenchef_encoded_size((isenchef_format_t)ctx->config.output_format, decoded);
+}
+
+int isenchef_ctx_transform(isenchef_ctx_t *ctx, const void *input, size_t size, void *output,
+                           size_t output_size, size_t *written) {
+    isenchef_format_t in_format = (isenchef_format_t)ctx->config.input_format;
+    isenchef_format_t out_format = (isenchef_format_t)ctx->config.output_format;
+    const uint8_t *src = (const uint8_t *)input;
+    size_t pos = 0;
+    size_t out = 0;
+    size_t consumed;
+    size_t produced;
+    size_t tail;
+
+    *written = 0;
+    if (output_size < isenchef_ctx_output_size(ctx, size)) {
+        return ISENCHEF_NO_SPACE;
+    }
+    if (isenchef_ctx_reset(ctx) < 0) {
+        return ISENCHEF_ERROR;
+    }
+    ctx_codecs_init(ctx);
+
+    /* raw output: decode straight into the caller's buffer and work there */
+    if (out_format == ISENCHEF_BYTES) {
+        uint8_t *dst = (uint8_t *)output;
+        size_t n = size;
+        if (in_format == ISENCHEF_BYTES) {
+            if (pipeline_run_copy(&ctx->pipeline, src, dst, size) < 0) {
+                return ISENCHEF_ERROR;
+            }
+        } else {
+            if (ctx_decode(ctx, in_format, (const char *)src, size, dst, output_size, &consumed,
+                           &produced) < 0 ||
+                ctx_decode_final(ctx, in_format, dst + produced, output_size - produced,
+                                 &tail) < 0) {
+                return ISENCHEF_ERROR;
+            }
+            n = produced + tail;
+            if (pipeline_run(&ctx->pipeline, dst, n) < 0) {
+                return ISENCHEF_ERROR;
+            }
+        }
+        *written = n;
+        return ISENCHEF_OK;
+    }
+
+    /* text output: one block at a time through the context's own buffer */
+    do {
+        size_t n;
+
+        if (in_format == ISENCHEF_BYTES) {
+            n = (size - pos < CTX_BLOCK_SIZE) ? size - pos : CTX_BLOCK_SIZE;
+            if (pipeline_run_copy(&ctx->pipeline, src + pos, ctx->block, n) < 0) {
+                return ISENCHEF_ERROR;
+            }
+            pos += n;
+        } else {
+            /* one byte spare for the padded last hex digit */
+            if (ctx_decode(ctx, in_format, (const char *)src + pos, size - pos, ctx->block,
+                           CTX_BLOCK_SIZE - 1, &consumed, &n) < 0) {
+                return ISENCHEF_ERROR;
+            }
+            pos += consumed;
+            if (pos == size) {
+                if (ctx_decode_final(ctx, in_format, ctx->block + n, CTX_BLOCK_SIZE - n,
+                                     &tail) < 0) {
+                    return ISENCHEF_ERROR;
+                }
+                n += tail;
+            }
+            if (pipeline_run(&ctx->pipeline, ctx->block, n) < 0) {
+                return ISENCHEF_ERROR;
+            }
+        }
+        /* the size check above leaves room for all of it */
+        ctx_encode(ctx, out_format, ctx->block, n, (char *)output + out, output_size - out,
+                   &consumed, &produced);
+        out += produced;
+    } while (pos < size);
+
+    if (ctx_encode_final(ctx, out_format, (char *)output + out, output_size - out, &tail) < 0) {
+        return ISENCHEF_ERROR;
+    }
+    out += tail;
+    ((char *)output)[out] = '\0';
+    *written = out;
+    return ISENCHEF_OK;
+}
@@ -3,19 +3,40 @@
  * @brief main entry point for isenchef tool
  */
 
+#include <string.h>
 #include "../include/isenchef.h"
 #include "../include/processor.h"
+#include "../include/workers.h"
+#include "../include/server.h"
+#include "../include/stats.h"
 
 int main(int argc, char *argv[]) {
     config_t config;
 
+    if (argc >= 2 && strcmp(argv[1], "client") == 0) {
+        return (client_main(argc - 2, argv + 2) < 0) ? 1 : 0;
+    }
+
     int parse_result = parse_arguments(argc, argv, &config);
     if (parse_result == -2) {
         return 0;
     } else if (parse_result < 0) {
+        free_config(&config);
         return 1;
     }
 
-    return execute_config(&config);
+    /* the server gives its threads to connections, not to data-parallel loops */
+    if (config.threads != 1 && !config.serve_socket && workers_start(config.threads) < 0) {
+        free_config(&config);
+        return 1;
+    }
+    stats_enable(config.stats != STATS_OFF);
+    int result = execute_config(&config);
+    if (config.stats != STATS_OFF) {
+        stats_print(stderr, config.stats);
+    }
+    workers_stop();
+    free_config(&config);
+    return result;
 }
 
@@ -0,0 +1,269 @@
+/**
+ * @file mapped_io.c
+ * @brief memory-mapped zero-copy path for raw byte jobs
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/mapped_io.h"
+#include "../include/pipeline.h"
+#include "../include/stats.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+/* run the configured steps from src into dst (src == dst for in place) */
+static int mapped_action(const config_t *config, const uint8_t *src, uint8_t *dst,
+                         size_t size, checksum_set_t *sums) {
+    pipeline_t pipeline;
+
+    if (pipeline_init(&pipeline, config->steps, config->step_count) < 0) {
+        return -1;
+    }
+    /* page faults land here, the mapped path has no separate read or write */
+    STATS_BEGIN(action_mark);
+    int result = pipeline_run_summed(&pipeline, src, dst, size, sums);
+    STATS_END(STATS_ACTION, action_mark, size, size);
+    pipeline_free(&pipeline);
+    return result;
+}
+
+static int same_file(const struct stat *a, const char *filename) {
+    struct stat b;
+    if (stat(filename, &b) < 0) {
+        return 0;
+    }
+    return a->st_dev == b.st_dev && a->st_ino == b.st_ino;
+}
+
+static int mapped_in_place(const char *filename, const config_t *config,
+                           checksum_set_t *sums) {
+    struct stat st;
+    uint8_t *data;
+    int result = -1;
+
+    int fd = open(filename, O_RDWR);
+    if (fd < 0) {
+        perror("opening input file");
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        perror("reading input file size");
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return mapped_action(config, NULL, NULL, 0, sums);
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mapping input file");
+        close(fd);
+        return -1;
+    }
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    if (mapped_action(config, data, data, (size_t)st.st_size, sums) < 0) {
+        fprintf(stderr, "failed to apply action\n");
+    } else {
+        result = 0;
+    }
+    munmap(data, (size_t)st.st_size);
+    close(fd);
+    return result;
+}
+
+/*
+ * write a transformed mapping to an output that cannot be mapped (stdout).
+ * a pipe is handed the pages themselves with vmsplice instead of a copy.
+ */
+static int mapped_write(int out_fd, const uint8_t *data, size_t size) {
+    size_t done = 0;
+    int to_pipe = 0;
+
+#ifdef __linux__
+    struct stat st;
+    to_pipe = fstat(out_fd, &st) == 0 && S_ISFIFO(st.st_mode);
+#endif
+    STATS_BEGIN(write_mark);
+    while (done < size) {
+        ssize_t n;
+#ifdef __linux__
+        if (to_pipe) {
+            struct iovec iov = {(void *)(data + done), size - done};
+            n = vmsplice(out_fd, &iov, 1, 0);
+        } else
+#endif
+        {
+            n = write(out_fd, data + done, size - done);
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (to_pipe && errno == EINVAL) {
+                to_pipe = 0;
+                continue;
+            }
+            perror("writing output file");
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    STATS_END(STATS_WRITE, write_mark, size, size);
+    return 0;
+}
+
+/*
+ * the input mapped private and writable is transformed in place, only the
+ * touched pages are copied (by the page faults), then written out.
+ */
+static int mapped_to_stdout(const config_t *config, int in_fd, size_t size,
+                            checksum_set_t *sums) {
+    pipeline_t pipeline;
+    uint8_t *data;
+    int result = -1;
+
+    if (size == 0) {
+        return 0;
+    }
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, in_fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mapping input file");
+        return -1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    if (pipeline_init(&pipeline, config->steps, config->step_count) < 0) {
+        munmap(data, size);
+        return -1;
+    }
+    STATS_BEGIN(action_mark);
+    int action = pipeline_run_summed(&pipeline, data, data, size, sums);
+    STATS_END(STATS_ACTION, action_mark, size, size);
+    pipeline_free(&pipeline);
+    if (action < 0) {
+        fprintf(stderr, "failed to apply action\n");
+    } else {
+        fflush(stdout);
+        result = mapped_write(STDOUT_FILENO, data, size);
+    }
+    /* vmsplice is done with the pages once it returns, they were given to the pipe */
+    munmap(data, size);
+    return result;
+}
+
+int mapped_execute(const config_t *config, checksum_set_t *sums) {
+    struct stat st;
+    uint8_t *src = MAP_FAILED;
+    uint8_t *dst = MAP_FAILED;
+    size_t size;
+    int in_fd = -1;
+    int out_fd = -1;
+    int result = -1;
+
+    if (config->input_format != FORMAT_BYTES || config->output_format != FORMAT_BYTES) {
+        fprintf(stderr, "memory-mapped mode needs bytes input and output formats\n");
+        return -1;
+    }
+    if (config->in_place) {
+        return mapped_in_place(config->input_file, config, sums);
+    }
+
+    in_fd = is_stdio_path(config->input_file) ? dup(STDIN_FILENO)
+                                              : open(config->input_file, O_RDONLY);
+    if (in_fd < 0) {
+        perror("opening input file");
+        return -1;
+    }
+    if (fstat(in_fd, &st) < 0) {
+        perror("reading input file size");
+        goto cleanup;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "memory-mapped mode needs a regular input file, not a pipe\n");
+        goto cleanup;
+    }
+    if (is_stdio_path(config->output_file)) {
+        result = mapped_to_stdout(config, in_fd, (size_t)st.st_size, sums);
+        goto cleanup;
+    }
+    /* truncating the output would destroy the input */
+    if (same_file(&st, config->output_file)) {
+        close(in_fd);
+        return mapped_in_place(config->input_file, config, sums);
+    }
+    size = (size_t)st.st_size;
+
+    out_fd = open(config->output_file, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (out_fd < 0) {
+        perror("opening output file");
+        goto cleanup;
+    }
+    if (size == 0) {
+        result = 0;
+        goto cleanup;
+    }
+#ifdef __linux__
+    /* real blocks up front rather than a sparse file filled through page faults */
+    fallocate(out_fd, 0, 0, (off_t)size);
+#endif
+    if (ftruncate(out_fd, (off_t)size) < 0) {
+        perror("sizing output file");
+        goto cleanup;
+    }
+
+    src = mmap(NULL, size, PROT_READ, MAP_PRIVATE, in_fd, 0);
+    if (src == MAP_FAILED) {
+        perror("mapping input file");
+        goto cleanup;
+    }
+    dst = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, out_fd, 0);
+    if (dst == MAP_FAILED) {
+        perror("mapping output file");
+        goto cleanup;
+    }
+    madvise(src, size, MADV_SEQUENTIAL);
+    madvise(dst, size, MADV_SEQUENTIAL);
+
+    if (mapped_action(config, src, dst, size, sums) < 0) {
+        fprintf(stderr, "failed to apply action\n");
+        goto cleanup;
+    }
+    result = 0;
+
+cleanup:
+    if (dst != MAP_FAILED) {
+        munmap(dst, size);
+    }
+    if (src != MAP_FAILED) {
+        munmap(src, size);
+    }
+    if (out_fd >= 0 && close(out_fd) < 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    close(in_fd);
+    return result;
+}
+
+#else
+
+int mapped_execute(const config_t *config, checksum_set_t *sums) {
+    (void)config;
+    (void)sums;
+    fprintf(stderr, "memory-mapped mode is not supported on this platform\n");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @file passthrough.c
+ * @brief copy of untouched data from input to output, in the kernel when possible
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/passthrough.h"
+#include "../include/stats.h"
+#include "../include/buffer_pool.h"
+
+/* bytes moved per splice/sendfile/read call */
+#define PASSTHROUGH_CHUNK (1024 * 1024)
+
+int passthrough_applies(const config_t *config) {
+    return config->input_format == FORMAT_BYTES && config->output_format == FORMAT_BYTES &&
+           config->step_count == 0 && config->output_count <= 1 &&
+           config->checksum_count == 0;
+}
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+typedef enum {
+    MOVE_SPLICE,
+    MOVE_SENDFILE,
+    MOVE_COPY
+} move_t;
+
+/* user-space fallback, for file systems and devices the kernel paths refuse */
+static ssize_t copy_chunk(int in_fd, int out_fd, uint8_t *buffer) {
+    ssize_t got = read(in_fd, buffer, PASSTHROUGH_CHUNK);
+    ssize_t done = 0;
+
+    while (done < got) {
+        ssize_t n = write(out_fd, buffer + done, (size_t)(got - done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += n;
+    }
+    return got;
+}
+
+int passthrough_execute(const config_t *config) {
+    int stdin_in = is_stdio_path(config->input_file);
+    int stdout_out = is_stdio_path(config->output_file);
+    struct stat in_st;
+    struct stat out_st;
+    uint8_t *buffer = NULL;
+    size_t capacity = 0;
+    size_t moved = 0;
+    int in_fd = STDIN_FILENO;
+    int out_fd = STDOUT_FILENO;
+    int result = -1;
+    move_t method;
+
+    if (!stdin_in) {
+        in_fd = open(config->input_file, O_RDONLY);
+        if (in_fd < 0) {
+            perror("opening input file");
+            return -1;
+        }
+    }
+    if (fstat(in_fd, &in_st) < 0) {
+        perror("reading input file");
+        goto cleanup;
+    }
+    /* truncating the output would destroy the input, which already holds the result */
+    if (!stdout_out && stat(config->output_file, &out_st) == 0 &&
+        out_st.st_dev == in_st.st_dev && out_st.st_ino == in_st.st_ino) {
+        out_fd = -1;  /* still stdout's descriptor */
+        result = 0;
+        goto cleanup;
+    }
+    if (!stdout_out) {
+        out_fd = open(config->output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out_fd < 0) {
+            perror("opening output file");
+            goto cleanup;
+        }
+    } else {
+        /* anything printed through stdio goes out first */
+        fflush(stdout);
+    }
+    if (fstat(out_fd, &out_st) < 0) {
+        perror("reading output file");
+        goto cleanup;
+    }
+    method = (S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode)) ? MOVE_SPLICE
+                                                                    : MOVE_SENDFILE;
+
+    STATS_BEGIN(write_mark);
+    for (;;) {
+        ssize_t n;
+
+        if (method == MOVE_SPLICE) {
+            n = splice(in_fd, NULL, out_fd, NULL, PASSTHROUGH_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+        } else if (method == MOVE_SENDFILE) {
+            n = sendfile(out_fd, in_fd, NULL, PASSTHROUGH_CHUNK);
+        } else {
+            n = copy_chunk(in_fd, out_fd, buffer);
+        }
+        if (n > 0) {
+            moved += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        /* splice needs a pipe on one side, sendfile a mappable input, e.g. not a tty */
+        if (method != MOVE_COPY && moved == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            buffer = (uint8_t *)pool_alloc(PASSTHROUGH_CHUNK, &capacity);
+            if (!buffer) {
+                goto cleanup;
+            }
+            method = MOVE_COPY;
+            continue;
+        }
+        perror("copying input to output");
+        goto cleanup;
+    }
+    STATS_END(STATS_WRITE, write_mark, moved, moved);
+    result = 0;
+
+cleanup:
+    pool_free(buffer, capacity);
+    if (!stdout_out && out_fd >= 0 && close(out_fd) < 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    if (!stdin_in) {
+        close(in_fd);
+    }
+    return result;
+}
+
+#else
+
+int passthrough_execute(const config_t *config) {
+    uint8_t *buffer;
+    size_t capacity;
+    FILE *in;
+    FILE *out;
+    size_t moved = 0;
+    int result = 0;
+
+    if (!is_stdio_path(config->input_file) &&
+        !is_stdio_path(config->output_file) &&
+        strcmp(config->input_file, config->output_file) == 0) {
+        return 0;
+    }
+    buffer = (uint8_t *)pool_alloc(PASSTHROUGH_CHUNK, &capacity);
+    if (!buffer) {
+        return -1;
+    }
+    in = open_input(config->input_file);
+    if (!in) {
+        perror("opening input file");
+        pool_free(buffer, capacity);
+        return -1;
+    }
+    out = open_output(config->output_file);
+    if (!out) {
+        perror("opening output file");
+        close_file(in);
+        pool_free(buffer, capacity);
+        return -1;
+    }
+
+    STATS_BEGIN(write_mark);
+    for (;;) {
+        size_t got = fread(buffer, 1, PASSTHROUGH_CHUNK, in);
+        if (got == 0) {
+            break;
+        }
+        if (fwrite(buffer, 1, got, out) != got) {
+            fprintf(stderr, "failed to write entire file\n");
+            result = -1;
+            break;
+        }
+        moved += got;
+    }
+    STATS_END(STATS_WRITE, write_mark, moved, moved);
+    if (ferror(in)) {
+        perror("reading input file");
+        result = -1;
+    }
+    if (close_file(out) != 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    close_file(in);
+    pool_free(buffer, capacity);
+    return result;
+}
+
+#endif
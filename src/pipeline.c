@@ -0,0 +1,249 @@
+/**
+ * @file pipeline.c
+ * @brief ordered chain of actions applied block by block
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../include/pipeline.h"
+#include "../include/workers.h"
+
+int pipeline_init(pipeline_t *pipeline, const recipe_step_t *steps, size_t count) {
+    pipeline->stages = NULL;
+    pipeline->count = 0;
+    pipeline->offset = 0;
+    pipeline->position_independent = 1;
+    if (count == 0) {
+        return 0;
+    }
+
+    pipeline->stages = (pipeline_stage_t *)calloc(count, sizeof(pipeline_stage_t));
+    if (!pipeline->stages) {
+        report_error("memory allocation failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        action_t action = steps[i].action;
+        int shift = (action == ACTION_CAESAR) ? atoi(steps[i].param) : 0;
+
+        if (bytemap_accepts(action)) {
+            pipeline_stage_t *last = NULL;
+            if (pipeline->count > 0) {
+                last = &pipeline->stages[pipeline->count - 1];
+            }
+            if (!last || last->kind != STAGE_BYTEMAP) {
+                last = &pipeline->stages[pipeline->count++];
+                last->kind = STAGE_BYTEMAP;
+                bytemap_init(&last->map);
+            }
+            bytemap_append(&last->map, action, shift);
+            continue;
+        }
+
+        pipeline_stage_t *stage = &pipeline->stages[pipeline->count++];
+        stage->kind = STAGE_ACTION;
+        stage->action = action;
+        stage->param = steps[i].param;
+        stage->shift = shift;
+        switch (action) {
+            case ACTION_RC4:
+                pipeline->position_independent = 0;
+                if (!stage->param || rc4_init(&stage->rc4, (const uint8_t *)stage->param,
+                                              strlen(stage->param), steps[i].drop) < 0) {
+                    report_error("invalid rc4 key\n");
+                    pipeline_free(pipeline);
+                    return -1;
+                }
+                stage->rc4_key = stage->rc4;
+                /* with spare cores the keystream is made ahead, off the data path */
+                if (workers_count() > 1) {
+                    stage->rc4_stream = rc4_stream_start(&stage->rc4);
+                    if (!stage->rc4_stream) {
+                        pipeline_free(pipeline);
+                        return -1;
+                    }
+                }
+                break;
+            case ACTION_XOR: {
+                int result = steps[i].param_hex ? xor_key_from_hex(&stage->xor, stage->param)
+                                                : xor_key_from_text(&stage->xor, stage->param);
+                if (result < 0) {
+                    report_error("invalid xor key\n");
+                    pipeline_free(pipeline);
+                    return -1;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
+static int stage_apply(pipeline_stage_t *stage, const uint8_t *src, uint8_t *dst, size_t size,
+                       uint64_t offset) {
+    if (stage->kind == STAGE_BYTEMAP) {
+        bytemap_apply(&stage->map, src, dst, size);
+        return 0;
+    }
+    switch (stage->action) {
+        case ACTION_NONE:
+            if (src != dst) {
+                memcpy(dst, src, size);
+            }
+            return 0;
+        case ACTION_CAESAR:
+            return action_caesar_copy(src, dst, size, stage->shift);
+        case ACTION_RC4:
+            if (stage->rc4_stream) {
+                rc4_stream_apply(stage->rc4_stream, src, dst, size);
+            } else {
+                rc4_process_copy(&stage->rc4, src, dst, size);
+            }
+            return 0;
+        case ACTION_UPPERCASE:
+            return action_uppercase_copy(src, dst, size);
+        case ACTION_LOWERCASE:
+            return action_lowercase_copy(src, dst, size);
+        case ACTION_XOR:
+            xor_apply(&stage->xor, src, dst, size, offset);
+            return 0;
+        default:
+            report_error("unknown action\n");
+            return -1;
+    }
+}
+
+/* run every stage over a range, one cache-sized block at a time */
+static int run_range(pipeline_t *pipeline, const uint8_t *src, uint8_t *dst, size_t size,
+                     uint64_t offset) {
+    for (size_t done = 0; done < size; done += PIPELINE_BLOCK_SIZE) {
+        size_t n = size - done;
+        if (n > PIPELINE_BLOCK_SIZE) {
+            n = PIPELINE_BLOCK_SIZE;
+        }
+
+        /* the first step moves the block, the others work on it in place */
+        if (stage_apply(&pipeline->stages[0], src + done, dst + done, n, offset + done) < 0) {
+            return -1;
+        }
+        for (size_t i = 1; i < pipeline->count; i++) {
+            if (stage_apply(&pipeline->stages[i], dst + done, dst + done, n, offset + done) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* arguments shared by the slices of a parallel run */
+typedef struct {
+    pipeline_t *pipeline;
+    const uint8_t *src;
+    uint8_t *dst;
+    size_t size;
+    atomic_int failed;
+} pipeline_job_t;
+
+static void run_slice(void *arg, size_t index) {
+    pipeline_job_t *job = (pipeline_job_t *)arg;
+    size_t start = index * WORKERS_SLICE_SIZE;
+    size_t n = job->size - start;
+    if (n > WORKERS_SLICE_SIZE) {
+        n = WORKERS_SLICE_SIZE;
+    }
+    if (run_range(job->pipeline, job->src + start, job->dst + start, n,
+                  job->pipeline->offset + start) < 0) {
+        atomic_store(&job->failed, 1);
+    }
+}
+
+int pipeline_run_copy(pipeline_t *pipeline, const uint8_t *src, uint8_t *dst, size_t size) {
+    int result = 0;
+
+    if (pipeline->count == 0) {
+        if (src != dst) {
+            memcpy(dst, src, size);
+        }
+    } else if (pipeline->position_independent && size >= WORKERS_MIN_PARALLEL &&
+               workers_count() > 1) {
+        pipeline_job_t job = {pipeline, src, dst, size, 0};
+        workers_run((size + WORKERS_SLICE_SIZE - 1) / WORKERS_SLICE_SIZE, run_slice, &job);
+        result = atomic_load(&job.failed) ? -1 : 0;
+    } else {
+        result = run_range(pipeline, src, dst, size, pipeline->offset);
+    }
+    pipeline->offset += size;
+    return result;
+}
+
+int pipeline_run(pipeline_t *pipeline, uint8_t *data, size_t size) {
+    return pipeline_run_copy(pipeline, data, data, size);
+}
+
+int pipeline_run_summed(pipeline_t *pipeline, const uint8_t *src, uint8_t *dst, size_t size,
+                        checksum_set_t *sums) {
+    if (!checksum_set_wants(sums, CHECKSUM_DECODED) &&
+        !checksum_set_wants(sums, CHECKSUM_TRANSFORMED)) {
+        return pipeline_run_copy(pipeline, src, dst, size);
+    }
+    for (size_t done = 0; done < size; done += PIPELINE_BLOCK_SIZE) {
+        size_t n = size - done;
+        if (n > PIPELINE_BLOCK_SIZE) {
+            n = PIPELINE_BLOCK_SIZE;
+        }
+        checksum_set_update(sums, CHECKSUM_DECODED, src + done, n);
+        if (pipeline_run_copy(pipeline, src + done, dst + done, n) < 0) {
+            return -1;
+        }
+        checksum_set_update(sums, CHECKSUM_TRANSFORMED, dst + done, n);
+    }
+    return 0;
+}
+
+int pipeline_reset(pipeline_t *pipeline) {
+    pipeline->offset = 0;
+    for (size_t i = 0; i < pipeline->count; i++) {
+        pipeline_stage_t *stage = &pipeline->stages[i];
+        if (stage->kind != STAGE_ACTION || stage->action != ACTION_RC4) {
+            continue;
+        }
+        stage->rc4 = stage->rc4_key;
+        if (stage->rc4_stream) {
+            /* the generator has run ahead, start a fresh one from the key */
+            rc4_stream_stop(stage->rc4_stream);
+            stage->rc4_stream = rc4_stream_start(&stage->rc4_key);
+            if (!stage->rc4_stream) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void pipeline_inline(pipeline_t *pipeline) {
+    for (size_t i = 0; i < pipeline->count; i++) {
+        pipeline_stage_t *stage = &pipeline->stages[i];
+        if (stage->kind == STAGE_ACTION && stage->action == ACTION_RC4 && stage->rc4_stream) {
+            rc4_stream_stop(stage->rc4_stream);
+            stage->rc4_stream = NULL;
+            stage->rc4 = stage->rc4_key;
+        }
+    }
+}
+
+void pipeline_free(pipeline_t *pipeline) {
+    for (size_t i = 0; i < pipeline->count; i++) {
+        pipeline_stage_t *stage = &pipeline->stages[i];
+        if (stage->kind == STAGE_ACTION && stage->action == ACTION_XOR) {
+            xor_key_free(&stage->xor);
+        } else if (stage->kind == STAGE_ACTION && stage->action == ACTION_RC4) {
+            rc4_stream_stop(stage->rc4_stream);
+        }
+    }
+    free(pipeline->stages);
+    pipeline->stages = NULL;
+    pipeline->count = 0;
+}
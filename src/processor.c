@@ -1,56 +1,301 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "../include/processor.h"
 #include "../include/isenchef.h"
-#include "../include/actions.h"
+#include "../include/pipeline.h"
+#include "../include/stream.h"
+#include "../include/mapped_io.h"
+#include "../include/passthrough.h"
+#include "../include/records.h"
+#include "../include/batch.h"
+#include "../include/server.h"
+#include "../include/stats.h"
+#include "../include/workers.h"
+#include "../include/checksum.h"
+#include "../include/analyze.h"
+#include "../include/encoders.h"
+#include "../include/buffer_pool.h"
 
-static int process_action(buffer_t *buffer, const config_t *config) {
-    if (config->action == ACTION_NONE) {
+/* blocks the output sums read right after they are encoded, a multiple of 3 */
+#define SUMMED_ENCODE_BLOCK (3 * 16 * 1024)
+
+static int process_action(buffer_t *buffer, const config_t *config, checksum_set_t *sums) {
+    pipeline_t pipeline;
+
+    if (config->step_count == 0 && !checksum_set_wants(sums, CHECKSUM_DECODED) &&
+        !checksum_set_wants(sums, CHECKSUM_TRANSFORMED)) {
         return 0;
     }
-    switch (config->action) {
-        case ACTION_CAESAR: {
-            int shift = atoi(config->action_param);
-            return action_caesar(buffer->data, buffer->size, shift);
-        }
-        case ACTION_RC4:
-            return action_rc4(buffer->data, buffer->size, config->action_param);
-        case ACTION_UPPERCASE:
-            return action_uppercase(buffer->data, buffer->size);
-        case ACTION_LOWERCASE:
-            return action_lowercase(buffer->data, buffer->size);
-        case ACTION_XOR:
-            return action_xor(buffer->data, buffer->size, config->action_param);
-        default:
-            fprintf(stderr, "unknown action\n");
-            return -1;
+    if (pipeline_init(&pipeline, config->steps, config->step_count) < 0) {
+        return -1;
     }
+    STATS_BEGIN(action_mark);
+    int result = pipeline_run_summed(&pipeline, buffer->data, buffer->data, buffer->size, sums);
+    STATS_END(STATS_ACTION, action_mark, buffer->size, buffer->size);
+    pipeline_free(&pipeline);
+    return result;
 }
 
-int execute_config(const config_t *config) {
+/*
+ * encode into scratch->encoded one block at a time, each block feeding the
+ * output sums while it is in cache. encode_scratch would split the work
+ * across the workers but leave the sums a second pass over the output.
+ */
+static int encode_summed(format_t format, const buffer_t *buffer, io_scratch_t *scratch,
+                         checksum_set_t *sums, buffer_t *encoded) {
+    size_t bound = (format == FORMAT_HEX) ? buffer->size * 2 + 1
+                                          : (buffer->size + 2) / 3 * 4 + 1;
+    size_t produced = 0;
+
+    char *output = (char *)pool_grow(scratch->encoded, &scratch->encoded_size, 0, bound);
+    if (!output) {
+        return -1;
+    }
+    scratch->encoded = output;
+    STATS_BEGIN(encode_mark);
+    for (size_t done = 0; done < buffer->size; done += SUMMED_ENCODE_BLOCK) {
+        size_t n = buffer->size - done;
+        size_t written;
+        if (n > SUMMED_ENCODE_BLOCK) {
+            n = SUMMED_ENCODE_BLOCK;
+        }
+        if (format == FORMAT_HEX) {
+            if (encode_hex(buffer->data + done, n, output + produced) < 0) {
+                return -1;
+            }
+            written = n * 2;
+        } else {
+            if (encode_base64(buffer->data + done, n, output + produced, bound - produced,
+                              &written) < 0) {
+                return -1;
+            }
+        }
+        checksum_set_update(sums, CHECKSUM_OUTPUT, output + produced, written);
+        produced += written;
+    }
+    STATS_END(STATS_ENCODE, encode_mark, buffer->size, produced);
+    encoded->data = (uint8_t *)output;
+    encoded->size = produced;
+    encoded->capacity = 0;
+    return 0;
+}
+
+/* the sinks of one output format, encoded once and written by one task */
+typedef struct {
+    const config_t *config;
+    const buffer_t *buffer;
+    io_scratch_t *scratch;
+    format_t formats[3];
+    checksum_set_t sums[3];  /* output sums of each format */
+    size_t format_count;
+    atomic_int failed;
+} fan_out_t;
+
+static void write_format(void *arg, size_t index) {
+    fan_out_t *fan = (fan_out_t *)arg;
+    const config_t *config = fan->config;
+    format_t format = fan->formats[index];
+    checksum_set_t *sums = &fan->sums[index];
+    io_scratch_t own = {0};
+    /* the first task encodes into the job's scratch, the others into their own */
+    io_scratch_t *scratch = (index == 0) ? fan->scratch : &own;
+    /* the encoded view is written as bytes, it is already in its final form */
+    buffer_t encoded = {0};
+    int result;
+
+    if (format != FORMAT_BYTES && checksum_set_wants(sums, CHECKSUM_OUTPUT)) {
+        result = encode_summed(format, fan->buffer, scratch, sums, &encoded);
+    } else {
+        const void *output;
+        result = encode_scratch(format, fan->buffer, scratch, &output, &encoded.size);
+        encoded.data = (uint8_t *)output;
+        checksum_set_update(sums, CHECKSUM_OUTPUT, encoded.data, encoded.size);
+    }
+    if (result < 0) {
+        atomic_store(&fan->failed, 1);
+        free_scratch(&own);
+        return;
+    }
+    for (size_t i = 0; i < config->output_count; i++) {
+        if (config->outputs[i].format != format) {
+            continue;
+        }
+        if (write_file_scratch(config->outputs[i].file, FORMAT_BYTES, &encoded, scratch,
+                               config->direct) < 0) {
+            fprintf(stderr, "failed to write output file %s\n", config->outputs[i].file);
+            atomic_store(&fan->failed, 1);
+        }
+    }
+    free_scratch(&own);
+}
+
+/*
+ * write one result to several sinks. every output format is encoded once,
+ * the formats are encoded and written at the same time on the workers.
+ */
+static int write_outputs(const config_t *config, const buffer_t *buffer, io_scratch_t *scratch,
+                         fan_out_t *fan) {
+    fan->config = config;
+    fan->buffer = buffer;
+    fan->scratch = scratch;
+    atomic_init(&fan->failed, 0);
+    for (size_t i = 0; i < config->output_count; i++) {
+        size_t j = 0;
+        while (j < fan->format_count && fan->formats[j] != config->outputs[i].format) {
+            j++;
+        }
+        if (j == fan->format_count) {
+            if (checksum_set_init(&fan->sums[j], config, 0) < 0) {
+                return -1;
+            }
+            fan->formats[fan->format_count++] = config->outputs[i].format;
+        }
+    }
+    workers_run(fan->format_count, write_format, fan);
+    return atomic_load(&fan->failed) ? -1 : 0;
+}
+
+/* read the whole input, transform it and write every output */
+static int run_whole_file(const config_t *config, io_scratch_t *scratch, checksum_set_t *sums,
+                          fan_out_t *fan) {
     buffer_t buffer = {0};
-    int result = 0;
-    if (read_file(config->input_file, config->input_format, &buffer) < 0) {
+
+    if (read_file_scratch(config->input_file, config->input_format, &buffer, scratch) < 0) {
         fprintf(stderr, "failed to read input file\n");
-        result = 1;
-        goto cleanup;
+        return -1;
     }
-    if (process_action(&buffer, config) < 0) {
+    if (process_action(&buffer, config, sums) < 0) {
         fprintf(stderr, "failed to apply action\n");
-        result = 1;
-        goto cleanup;
+        return -1;
+    }
+    if (config->output_count > 1) {
+        return write_outputs(config, &buffer, scratch, fan);
+    }
+    if (config->output_format != FORMAT_BYTES && checksum_set_wants(sums, CHECKSUM_OUTPUT)) {
+        buffer_t encoded;
+        if (encode_summed(config->output_format, &buffer, scratch, sums, &encoded) < 0 ||
+            write_file_scratch(config->output_file, FORMAT_BYTES, &encoded, scratch,
+                               config->direct) < 0) {
+            fprintf(stderr, "failed to write output file\n");
+            return -1;
+        }
+        return 0;
     }
-    if (write_file(config->output_file, config->output_format, &buffer) < 0) {
+    if (write_file_scratch(config->output_file, config->output_format, &buffer, scratch,
+                           config->direct) < 0) {
         fprintf(stderr, "failed to write output file\n");
-        result = 1;
-        goto cleanup;
+        return -1;
     }
-    printf("processed file: %s -> %s\n",
-           config->input_file, config->output_file);
+    return 0;
+}
+
+/* print the sums to stdout or append them to --checksum-file */
+static int report_checksums(const config_t *config, const checksum_set_t *sums,
+                            const fan_out_t *fan) {
+    FILE *report = stdout;
 
-cleanup:
-    free_buffer(&buffer);
+    if (config->checksum_file) {
+        report = fopen(config->checksum_file, "a");
+        if (!report) {
+            perror("opening checksum file");
+            return -1;
+        }
+    }
+    checksum_set_print(sums, report, CHECKSUM_DECODED, config->input_file);
+    checksum_set_print(sums, report, CHECKSUM_TRANSFORMED, config->input_file);
+    if (config->output_count > 1) {
+        for (size_t i = 0; i < config->output_count; i++) {
+            for (size_t j = 0; j < fan->format_count; j++) {
+                if (fan->formats[j] == config->outputs[i].format) {
+                    checksum_set_print(&fan->sums[j], report, CHECKSUM_OUTPUT,
+                                       config->outputs[i].file);
+                }
+            }
+        }
+    } else {
+        checksum_set_print(sums, report, CHECKSUM_OUTPUT, config->output_file);
+    }
+    if (report != stdout && fclose(report) != 0) {
+        perror("writing checksum file");
+        return -1;
+    }
+    return 0;
+}
+
+int execute_job(const config_t *config, io_scratch_t *scratch) {
+    checksum_set_t sums;
+    fan_out_t fan;
+    int result;
+
+    if (config->analyze != ANALYZE_NONE) {
+        return analyze_execute(config, scratch);
+    }
+    if (config->records != RECORDS_NONE) {
+        if (records_execute(config) < 0) {
+            fprintf(stderr, "failed to process records\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (passthrough_applies(config)) {
+        if (passthrough_execute(config) < 0) {
+            fprintf(stderr, "failed to copy input file\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    /* a single bytes output is the transformed data, its sums are taken with it */
+    int raw_output = config->output_format == FORMAT_BYTES && config->output_count <= 1;
+    if (checksum_set_init(&sums, config, raw_output) < 0) {
+        return -1;
+    }
+    memset(&fan, 0, sizeof(fan));
+    if (config->streaming) {
+        result = stream_execute(config, &sums);
+        if (result < 0) {
+            fprintf(stderr, "failed to stream input file\n");
+        }
+    } else if (config->mapped) {
+        result = mapped_execute(config, &sums);
+        if (result < 0) {
+            fprintf(stderr, "failed to process mapped file\n");
+        }
+    } else {
+        result = run_whole_file(config, scratch, &sums, &fan);
+    }
+    if (result == 0 && sums.count > 0) {
+        result = report_checksums(config, &sums, &fan);
+    }
+    for (size_t i = 0; i < fan.format_count; i++) {
+        checksum_set_free(&fan.sums[i]);
+    }
+    checksum_set_free(&sums);
     return result;
 }
 
+int execute_config(const config_t *config) {
+    io_scratch_t scratch = {0};
+
+    if (config->serve_socket) {
+        return (serve_execute(config) < 0) ? 1 : 0;
+    }
+    if (config->batch_file || config->batch_dir) {
+        return (batch_execute(config) < 0) ? 1 : 0;
+    }
+    int result = execute_job(config, &scratch);
+    free_scratch(&scratch);
+    if (result < 0) {
+        return 1;
+    }
+    /* stdout carries the data itself */
+    for (size_t i = 0; i < config->output_count || i == 0; i++) {
+        const char *output = config->output_count ? config->outputs[i].file : config->output_file;
+        if (!is_stdio_path(output)) {
+            printf("processed file: %s -> %s\n", config->input_file, output);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file rc4.c
+ * @brief rc4 stream cipher, inline or with the keystream made on its own thread
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/isenchef.h"
+#include "../include/rc4.h"
+
+/* the ring holds RC4_RING_BLOCKS blocks, the generator may run that far ahead */
+#define RC4_RING_BLOCK (64 * 1024)
+#define RC4_RING_BLOCKS 8
+
+struct rc4_stream {
+    rc4_state_t state;  /* owned by the generator thread */
+    uint8_t *ring;
+    size_t produced;    /* blocks written so far */
+    size_t consumed;    /* blocks fully used so far */
+    size_t used;        /* bytes used in the current block */
+    int stopping;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+};
+
+int rc4_init(rc4_state_t *state, const uint8_t *key, size_t key_len, size_t drop) {
+    uint8_t *S = state->S;
+    uint8_t j = 0;
+
+    if (!key || key_len == 0) {
+        return -1;
+    }
+    for (int i = 0; i < 256; i++) {
+        S[i] = (uint8_t)i;
+    }
+    for (int i = 0; i < 256; i++) {
+        j = (uint8_t)(j + S[i] + key[(size_t)i % key_len]);
+        uint8_t temp = S[i];
+        S[i] = S[j];
+        S[j] = temp;
+    }
+    state->i = 0;
+    state->j = 0;
+
+    /* rc4-drop[n]: throw away the weak first bytes of the keystream */
+    uint8_t discard[256];
+    while (drop > 0) {
+        size_t n = (drop < sizeof(discard)) ? drop : sizeof(discard);
+        rc4_keystream(state, discard, n);
+        drop -= n;
+    }
+    return 0;
+}
+
+/* uint8_t indices wrap by themselves, no % 256 and no state behind pointers */
+void rc4_keystream(rc4_state_t *state, uint8_t *out, size_t size) {
+    uint8_t *S = state->S;
+    uint8_t i = state->i;
+    uint8_t j = state->j;
+
+    for (size_t k = 0; k < size; k++) {
+        i++;
+        uint8_t si = S[i];
+        j = (uint8_t)(j + si);
+        uint8_t sj = S[j];
+        S[i] = sj;
+        S[j] = si;
+        out[k] = S[(uint8_t)(si + sj)];
+    }
+    state->i = i;
+    state->j = j;
+}
+
+void rc4_process(rc4_state_t *state, uint8_t *data, size_t size) {
+    rc4_process_copy(state, data, data, size);
+}
+
+void rc4_process_copy(rc4_state_t *state, const uint8_t *src, uint8_t *dst, size_t size) {
+    uint8_t *S = state->S;
+    uint8_t i = state->i;
+    uint8_t j = state->j;
+
+    for (size_t k = 0; k < size; k++) {
+        i++;
+        uint8_t si = S[i];
+        j = (uint8_t)(j + si);
+        uint8_t sj = S[j];
+        S[i] = sj;
+        S[j] = si;
+        dst[k] = src[k] ^ S[(uint8_t)(si + sj)];
+    }
+    state->i = i;
+    state->j = j;
+}
+
+static void *generator_main(void *arg) {
+    rc4_stream_t *stream = (rc4_stream_t *)arg;
+
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (!stream->stopping && stream->produced - stream->consumed == RC4_RING_BLOCKS) {
+            pthread_cond_wait(&stream->not_full, &stream->lock);
+        }
+        if (stream->stopping) {
+            break;
+        }
+        /* the consumer never reads this block until produced moves past it */
+        uint8_t *block = stream->ring + (stream->produced % RC4_RING_BLOCKS) * RC4_RING_BLOCK;
+        pthread_mutex_unlock(&stream->lock);
+        rc4_keystream(&stream->state, block, RC4_RING_BLOCK);
+        pthread_mutex_lock(&stream->lock);
+        stream->produced++;
+        pthread_cond_signal(&stream->not_empty);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+rc4_stream_t *rc4_stream_start(const rc4_state_t *state) {
+    rc4_stream_t *stream = (rc4_stream_t *)calloc(1, sizeof(rc4_stream_t));
+    if (!stream) {
+        report_error("memory allocation failed\n");
+        return NULL;
+    }
+    stream->ring = (uint8_t *)malloc((size_t)RC4_RING_BLOCKS * RC4_RING_BLOCK);
+    if (!stream->ring) {
+        report_error("memory allocation failed\n");
+        free(stream);
+        return NULL;
+    }
+    stream->state = *state;
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->not_full, NULL);
+    pthread_cond_init(&stream->not_empty, NULL);
+    if (pthread_create(&stream->thread, NULL, generator_main, stream) != 0) {
+        report_error("failed to start keystream thread\n");
+        pthread_cond_destroy(&stream->not_empty);
+        pthread_cond_destroy(&stream->not_full);
+        pthread_mutex_destroy(&stream->lock);
+        free(stream->ring);
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+static void xor_block(const uint8_t *src, const uint8_t *key, uint8_t *dst, size_t size) {
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        uint64_t mask;
+        memcpy(&word, src + i, 8);
+        memcpy(&mask, key + i, 8);
+        word ^= mask;
+        memcpy(dst + i, &word, 8);
+    }
+    for (; i < size; i++) {
+        dst[i] = src[i] ^ key[i];
+    }
+}
+
+void rc4_stream_apply(rc4_stream_t *stream, const uint8_t *src, uint8_t *dst, size_t size) {
+    size_t done = 0;
+
+    while (done < size) {
+        if (stream->used == 0) {
+            pthread_mutex_lock(&stream->lock);
+            while (stream->produced == stream->consumed) {
+                pthread_cond_wait(&stream->not_empty, &stream->lock);
+            }
+            pthread_mutex_unlock(&stream->lock);
+        }
+
+        const uint8_t *key = stream->ring + (stream->consumed % RC4_RING_BLOCKS) * RC4_RING_BLOCK;
+        size_t n = RC4_RING_BLOCK - stream->used;
+        if (n > size - done) {
+            n = size - done;
+        }
+        xor_block(src + done, key + stream->used, dst + done, n);
+        stream->used += n;
+        done += n;
+
+        if (stream->used == RC4_RING_BLOCK) {
+            pthread_mutex_lock(&stream->lock);
+            stream->consumed++;
+            pthread_cond_signal(&stream->not_full);
+            pthread_mutex_unlock(&stream->lock);
+            stream->used = 0;
+        }
+    }
+}
+
+void rc4_stream_stop(rc4_stream_t *stream) {
+    if (!stream) {
+        return;
+    }
+    pthread_mutex_lock(&stream->lock);
+    stream->stopping = 1;
+    pthread_cond_signal(&stream->not_full);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->thread, NULL);
+
+    pthread_cond_destroy(&stream->not_empty);
+    pthread_cond_destroy(&stream->not_full);
+    pthread_mutex_destroy(&stream->lock);
+    free(stream->ring);
+    free(stream);
+}
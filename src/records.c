@@ -0,0 +1,365 @@
+/**
+ * @file records.c
+ * @brief record-oriented mode, every line or length-prefixed record transformed on its own
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../include/records.h"
+#include "../include/pipeline.h"
+#include "../include/encoders.h"
+#include "../include/workers.h"
+#include "../include/stats.h"
+#include "../include/buffer_pool.h"
+
+/* record groups per worker and batch, so a few long records do not leave threads idle */
+#define RECORDS_GROUPS_PER_WORKER 4
+
+/* bytes of the length in front of a record */
+#define RECORD_PREFIX 4
+
+/* one record of the batch, without its newline or length prefix */
+typedef struct {
+    size_t start;
+    size_t length;
+} record_t;
+
+/* consecutive records handled by one task, with its own pipeline and output */
+typedef struct {
+    pipeline_t pipeline;
+    size_t first;      /* records[first, last) of the current batch */
+    size_t last;
+    uint8_t *data;     /* transformed record waiting to be encoded */
+    size_t data_size;
+    uint8_t *out;      /* framed output of the group, written once the batch is done */
+    size_t out_size;
+    size_t out_len;
+} record_group_t;
+
+typedef struct {
+    const config_t *config;
+    const uint8_t *batch;
+    const record_t *records;
+    record_group_t *groups;
+    unsigned long long first_number;  /* of the batch, for error messages */
+    atomic_int failed;
+} records_job_t;
+
+static size_t decoded_bound(format_t format, size_t length) {
+    if (format == FORMAT_HEX) {
+        return (length + 1) / 2;
+    }
+    if (format == FORMAT_BASE64) {
+        return length / 4 * 3 + 3;
+    }
+    return length;
+}
+
+/* with room for the terminator the encoders write */
+static size_t encoded_bound(format_t format, size_t size) {
+    if (format == FORMAT_HEX) {
+        return size * 2 + 1;
+    }
+    if (format == FORMAT_BASE64) {
+        return (size + 2) / 3 * 4 + 1;
+    }
+    return size;
+}
+
+/* decode, transform and encode one record at the end of the group output */
+static int process_record(records_job_t *job, record_group_t *group, const record_t *record) {
+    const config_t *config = job->config;
+    const char *text = (const char *)job->batch + record->start;
+    const int prefixed = config->records == RECORDS_LENGTH;
+    size_t decoded = decoded_bound(config->input_format, record->length);
+    size_t bound = RECORD_PREFIX + encoded_bound(config->output_format, decoded) + 1;
+    size_t size = record->length;
+    size_t encoded;
+
+    uint8_t *out = (uint8_t *)pool_grow(group->out, &group->out_size, group->out_len,
+                                        group->out_len + bound);
+    if (!out) {
+        return -1;
+    }
+    group->out = out;
+    uint8_t *body = out + group->out_len + (prefixed ? RECORD_PREFIX : 0);
+
+    /* bytes output is transformed straight into place, the others through data */
+    uint8_t *dest = body;
+    if (config->output_format != FORMAT_BYTES) {
+        uint8_t *data = (uint8_t *)pool_grow(group->data, &group->data_size, 0, decoded);
+        if (!data) {
+            return -1;
+        }
+        group->data = data;
+        dest = data;
+    }
+
+    if (pipeline_reset(&group->pipeline) < 0) {
+        return -1;
+    }
+    if (config->input_format == FORMAT_BYTES) {
+        if (pipeline_run_copy(&group->pipeline, (const uint8_t *)text, dest, size) < 0) {
+            return -1;
+        }
+    } else {
+        int status = (config->input_format == FORMAT_HEX)
+                    ? decode_hex_len(text, record->length, dest, decoded, &size)
+                    : decode_base64_len(text, record->length, dest, decoded, &size);
+        if (status < 0) {
+            fprintf(stderr, "record %llu: invalid %s format\n",
+                    job->first_number + (unsigned long long)(record - job->records) + 1,
+                    (config->input_format == FORMAT_HEX) ? "hex" : "base64");
+            return -1;
+        }
+        if (pipeline_run(&group->pipeline, dest, size) < 0) {
+            return -1;
+        }
+    }
+
+    if (config->output_format == FORMAT_HEX) {
+        if (encode_hex(dest, size, (char *)body) < 0) {
+            return -1;
+        }
+        encoded = size * 2;
+    } else if (config->output_format == FORMAT_BASE64) {
+        if (encode_base64(dest, size, (char *)body, bound - RECORD_PREFIX, &encoded) < 0) {
+            return -1;
+        }
+    } else {
+        encoded = size;
+    }
+
+    if (prefixed) {
+        if (encoded > UINT32_MAX) {
+            fprintf(stderr, "record too long for a 4-byte length\n");
+            return -1;
+        }
+        uint8_t *prefix = out + group->out_len;
+        prefix[0] = (uint8_t)(encoded >> 24);
+        prefix[1] = (uint8_t)(encoded >> 16);
+        prefix[2] = (uint8_t)(encoded >> 8);
+        prefix[3] = (uint8_t)encoded;
+        group->out_len += RECORD_PREFIX + encoded;
+    } else {
+        body[encoded] = '\n';
+        group->out_len += encoded + 1;
+    }
+    return 0;
+}
+
+static void process_group(void *arg, size_t index) {
+    records_job_t *job = (records_job_t *)arg;
+    record_group_t *group = &job->groups[index];
+
+    for (size_t i = group->first; i < group->last; i++) {
+        if (process_record(job, group, &job->records[i]) < 0) {
+            atomic_store(&job->failed, 1);
+            return;
+        }
+    }
+}
+
+static int add_record(record_t **records, size_t *count, size_t *capacity, size_t start,
+                      size_t length) {
+    if (*count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 1024;
+        record_t *bigger = (record_t *)realloc(*records, grown * sizeof(record_t));
+        if (!bigger) {
+            fprintf(stderr, "memory allocation failed\n");
+            return -1;
+        }
+        *records = bigger;
+        *capacity = grown;
+    }
+    (*records)[*count].start = start;
+    (*records)[*count].length = length;
+    (*count)++;
+    return 0;
+}
+
+/*
+ * find the complete records at the front of a batch. used is set to the
+ * bytes they take, the rest is an unfinished record carried over to the
+ * next batch. at the end of the input a last line without a newline is
+ * still a record, a cut length-prefixed record is an error.
+ */
+static int split_records(int mode, const uint8_t *batch, size_t filled, int eof,
+                         record_t **records, size_t *count, size_t *capacity, size_t *used) {
+    size_t pos = 0;
+
+    *count = 0;
+    if (mode == RECORDS_LINES) {
+        while (pos < filled) {
+            const uint8_t *newline = (const uint8_t *)memchr(batch + pos, '\n', filled - pos);
+            size_t end = newline ? (size_t)(newline - batch) : filled;
+            if (!newline && !eof) {
+                break;
+            }
+            size_t length = end - pos;
+            if (length > 0 && batch[end - 1] == '\r') {
+                length--;
+            }
+            if (add_record(records, count, capacity, pos, length) < 0) {
+                return -1;
+            }
+            pos = newline ? end + 1 : end;
+        }
+    } else {
+        while (filled - pos >= RECORD_PREFIX) {
+            const uint8_t *prefix = batch + pos;
+            size_t length = ((size_t)prefix[0] << 24) | ((size_t)prefix[1] << 16) |
+                            ((size_t)prefix[2] << 8) | (size_t)prefix[3];
+            if (filled - pos - RECORD_PREFIX < length) {
+                break;
+            }
+            if (add_record(records, count, capacity, pos + RECORD_PREFIX, length) < 0) {
+                return -1;
+            }
+            pos += RECORD_PREFIX + length;
+        }
+        if (eof && pos < filled) {
+            fprintf(stderr, "truncated record at the end of the input\n");
+            return -1;
+        }
+    }
+    *used = pos;
+    return 0;
+}
+
+int records_execute(const config_t *config) {
+    FILE *in = NULL;
+    FILE *out = NULL;
+    uint8_t *batch = NULL;
+    size_t batch_size = 0;
+    size_t filled = 0;
+    record_t *records = NULL;
+    size_t record_capacity = 0;
+    record_group_t *groups = NULL;
+    size_t group_count = (size_t)workers_count() * RECORDS_GROUPS_PER_WORKER;
+    size_t ready = 0;
+    records_job_t job;
+    int eof = 0;
+    int result = -1;
+
+    memset(&job, 0, sizeof(job));
+    job.config = config;
+    groups = (record_group_t *)calloc(group_count, sizeof(record_group_t));
+    batch = (uint8_t *)pool_alloc(RECORDS_BATCH, &batch_size);
+    if (!groups || !batch) {
+        fprintf(stderr, "memory allocation failed\n");
+        goto cleanup;
+    }
+    /* every record restarts the pipeline, rc4 runs inline instead of restarting a thread */
+    for (; ready < group_count; ready++) {
+        if (pipeline_init(&groups[ready].pipeline, config->steps, config->step_count) < 0) {
+            goto cleanup;
+        }
+        pipeline_inline(&groups[ready].pipeline);
+    }
+
+    in = open_input(config->input_file);
+    if (!in) {
+        perror("opening input file");
+        goto cleanup;
+    }
+    if (output_is_input(in, config->output_file)) {
+        fprintf(stderr, "--records cannot write over its input, use another --out\n");
+        goto cleanup;
+    }
+    out = open_output(config->output_file);
+    if (!out) {
+        perror("opening output file");
+        goto cleanup;
+    }
+
+    while (!eof || filled > 0) {
+        size_t count;
+        size_t used;
+
+        if (!eof) {
+            STATS_BEGIN(read_mark);
+            size_t n = fread(batch + filled, 1, batch_size - filled, in);
+            if (n < batch_size - filled) {
+                if (ferror(in)) {
+                    perror("reading input file");
+                    goto cleanup;
+                }
+                eof = 1;
+            }
+            filled += n;
+            STATS_END(STATS_READ, read_mark, n, n);
+        }
+        if (split_records(config->records, batch, filled, eof, &records, &count,
+                          &record_capacity, &used) < 0) {
+            goto cleanup;
+        }
+        if (count == 0) {
+            /* one record longer than the batch */
+            if (filled == batch_size) {
+                uint8_t *bigger = (uint8_t *)pool_grow(batch, &batch_size, filled, batch_size * 2);
+                if (!bigger) {
+                    fprintf(stderr, "memory allocation failed\n");
+                    goto cleanup;
+                }
+                batch = bigger;
+            }
+            continue;
+        }
+
+        size_t tasks = (count < group_count) ? count : group_count;
+        for (size_t g = 0; g < tasks; g++) {
+            groups[g].first = count * g / tasks;
+            groups[g].last = count * (g + 1) / tasks;
+            groups[g].out_len = 0;
+        }
+        job.batch = batch;
+        job.records = records;
+        job.groups = groups;
+        atomic_init(&job.failed, 0);
+        STATS_BEGIN(action_mark);
+        workers_run(tasks, process_group, &job);
+        if (atomic_load(&job.failed)) {
+            goto cleanup;
+        }
+        size_t produced = 0;
+        for (size_t g = 0; g < tasks; g++) {
+            produced += groups[g].out_len;
+        }
+        STATS_END(STATS_ACTION, action_mark, used, produced);
+
+        STATS_BEGIN(write_mark);
+        for (size_t g = 0; g < tasks; g++) {
+            if (fwrite(groups[g].out, 1, groups[g].out_len, out) != groups[g].out_len) {
+                perror("writing output file");
+                goto cleanup;
+            }
+        }
+        STATS_END(STATS_WRITE, write_mark, produced, produced);
+
+        job.first_number += count;
+        memmove(batch, batch + used, filled - used);
+        filled -= used;
+    }
+    result = 0;
+
+cleanup:
+    if (out && close_file(out) != 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    if (in) {
+        close_file(in);
+    }
+    for (size_t g = 0; g < ready; g++) {
+        pipeline_free(&groups[g].pipeline);
+        pool_free(groups[g].data, groups[g].data_size);
+        pool_free(groups[g].out, groups[g].out_size);
+    }
+    free(groups);
+    free(records);
+    pool_free(batch, batch_size);
+    return result;
+}
@@ -0,0 +1,612 @@
+/**
+ * @file server.c
+ * @brief warm daemon answering transform requests on a unix socket, and its client
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "../include/server.h"
+#include "../include/processor.h"
+#include "../include/pipeline.h"
+#include "../include/analyze.h"
+#include "../include/records.h"
+
+#define REQUEST_HEADER_SIZE 16
+#define RESPONSE_HEADER_SIZE 12
+
+/* how often an idle connection checks whether the server is stopping (ms) */
+#define IDLE_POLL_MS 250
+
+/* inline recipe kept by a connection between requests */
+typedef struct {
+    char *args;      /* request args the pipeline was built from */
+    char *split;     /* copy of args cut into words, config points into it */
+    char **argv;
+    config_t config;
+    pipeline_t pipeline;
+    int ready;
+} recipe_cache_t;
+
+static int listen_fd = -1;
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+    /* wakes every thread blocked in accept */
+    shutdown(listen_fd, SHUT_RDWR);
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+    for (int i = 3; i >= 0; i--) {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static void put_u64(uint8_t *p, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return ((uint64_t)get_u32(p) << 32) | get_u32(p + 4);
+}
+
+/* 1 when size bytes were read, 0 on end of stream before the first byte, -1 otherwise */
+static int read_full(int fd, void *buffer, size_t size) {
+    uint8_t *p = (uint8_t *)buffer;
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t n = read(fd, p + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return (n == 0 && done == 0) ? 0 : -1;
+        }
+        done += (size_t)n;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const void *buffer, size_t size) {
+    const uint8_t *p = (const uint8_t *)buffer;
+
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_response(int fd, uint32_t status, const void *body, size_t size) {
+    uint8_t header[RESPONSE_HEADER_SIZE];
+
+    put_u32(header, status);
+    put_u64(header + 4, size);
+    if (write_full(fd, header, sizeof(header)) < 0) {
+        return -1;
+    }
+    return write_full(fd, body, size);
+}
+
+static int send_error(int fd, const char *message) {
+    return send_response(fd, 1, message, strlen(message));
+}
+
+static void cache_drop(recipe_cache_t *cache) {
+    if (cache->ready) {
+        pipeline_free(&cache->pipeline);
+        free_config(&cache->config);
+    }
+    free(cache->args);
+    free(cache->split);
+    free(cache->argv);
+    memset(cache, 0, sizeof(recipe_cache_t));
+}
+
+/*
+ * parse args as a job, with placeholder files when the data travels inline.
+ * reason is set to the reply for a job the server cannot run.
+ */
+static int parse_request(char *split, char ***argv_out, config_t *config, int inline_data,
+                         const char **reason) {
+    static char *const placeholders[] = {"--in", "<inline>", "--out", "<inline>"};
+    int argc;
+    char **words = split_arguments(split, &argc);
+    char **argv;
+
+    *argv_out = NULL;
+    *reason = "invalid request";
+    if (!words) {
+        return -1;
+    }
+    argv = (char **)malloc(((size_t)argc + 5) * sizeof(char *));
+    if (!argv) {
+        fprintf(stderr, "memory allocation failed\n");
+        free(words);
+        return -1;
+    }
+    argv[0] = words[0];
+    int count = 1;
+    if (inline_data) {
+        for (int i = 0; i < 4; i++) {
+            argv[count++] = placeholders[i];
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        argv[count++] = words[i];
+    }
+    argv[count] = NULL;
+    free(words);
+    *argv_out = argv;
+
+    if (parse_arguments(count, argv, config) != 0) {
+        free_config(config);
+        return -1;
+    }
+    if (config->batch_file || config->batch_dir || config->serve_socket) {
+        free_config(config);
+        return -1;
+    }
+    /* reports would go to the daemon's stdout or working directory, not back to the client */
+    if (config->analyze != ANALYZE_NONE) {
+        *reason = "--analyze is not available through the server";
+        free_config(config);
+        return -1;
+    }
+    if (config->checksum_count > 0) {
+        *reason = "--checksum is not available through the server";
+        free_config(config);
+        return -1;
+    }
+    /* inline data is decoded as one message, records need --in and --out files */
+    if (inline_data && config->records != RECORDS_NONE) {
+        *reason = "--records needs --in and --out files through the server";
+        free_config(config);
+        return -1;
+    }
+    return 0;
+}
+
+/* make cache hold a pipeline for args, reusing the key schedules when args did not change */
+static int cache_prepare(recipe_cache_t *cache, const char *args, const char **reason) {
+    if (cache->ready && strcmp(cache->args, args) == 0) {
+        return pipeline_reset(&cache->pipeline);
+    }
+    cache_drop(cache);
+
+    size_t len = strlen(args);
+    cache->args = (char *)malloc(len + 1);
+    cache->split = (char *)malloc(len + 1);
+    if (!cache->args || !cache->split) {
+        fprintf(stderr, "memory allocation failed\n");
+        cache_drop(cache);
+        return -1;
+    }
+    memcpy(cache->args, args, len + 1);
+    memcpy(cache->split, args, len + 1);
+    if (parse_request(cache->split, &cache->argv, &cache->config, 1, reason) < 0) {
+        cache_drop(cache);
+        return -1;
+    }
+    if (pipeline_init(&cache->pipeline, cache->config.steps, cache->config.step_count) < 0) {
+        free_config(&cache->config);
+        cache_drop(cache);
+        return -1;
+    }
+    cache->ready = 1;
+    return 0;
+}
+
+static int handle_inline(int fd, recipe_cache_t *cache, io_scratch_t *scratch, const char *args,
+                         uint64_t payload_len) {
+    buffer_t buffer;
+    const void *output;
+    size_t output_size;
+
+    /* the payload is read first so the connection stays in step whatever happens */
+    if (!scratch_text(scratch, (size_t)payload_len) ||
+        (payload_len > 0 && read_full(fd, scratch->text, (size_t)payload_len) != 1)) {
+        return -1;
+    }
+    const char *reason = "invalid request";
+    if (cache_prepare(cache, args, &reason) < 0) {
+        return send_error(fd, reason);
+    }
+    if (decode_scratch(cache->config.input_format, (size_t)payload_len, &buffer, scratch) < 0) {
+        return send_error(fd, "invalid input format");
+    }
+    if (pipeline_run(&cache->pipeline, buffer.data, buffer.size) < 0) {
+        return send_error(fd, "failed to apply action");
+    }
+    if (encode_scratch(cache->config.output_format, &buffer, scratch, &output, &output_size) < 0) {
+        return send_error(fd, "failed to encode output");
+    }
+    return send_response(fd, 0, output, output_size);
+}
+
+static int handle_files(int fd, io_scratch_t *scratch, char *args) {
+    char **argv;
+    config_t config;
+    char message[512];
+    const char *reason;
+
+    if (parse_request(args, &argv, &config, 0, &reason) < 0) {
+        free(argv);
+        return send_error(fd, reason);
+    }
+    int result = execute_job(&config, scratch);
+    snprintf(message, sizeof(message), "processed file: %s -> %s", config.input_file,
+             config.output_file);
+    free_config(&config);
+    free(argv);
+    if (result < 0) {
+        return send_error(fd, "job failed, see the server log");
+    }
+    return send_response(fd, 0, message, strlen(message));
+}
+
+static void serve_connection(int fd, io_scratch_t *scratch) {
+    recipe_cache_t cache;
+    char *args = NULL;
+
+    memset(&cache, 0, sizeof(cache));
+    while (!stopping) {
+        uint8_t header[REQUEST_HEADER_SIZE];
+        struct pollfd pfd = {fd, POLLIN, 0};
+
+        int ready = poll(&pfd, 1, IDLE_POLL_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+        if (ready < 0 || read_full(fd, header, sizeof(header)) != 1) {
+            break;
+        }
+        uint32_t flags = get_u32(header);
+        uint32_t args_len = get_u32(header + 4);
+        uint64_t payload_len = get_u64(header + 8);
+        if (args_len > SERVER_MAX_ARGS || payload_len > SERVER_MAX_PAYLOAD ||
+            (!(flags & SERVER_INLINE) && payload_len > 0)) {
+            send_error(fd, "request too large");
+            break;
+        }
+
+        args = (char *)malloc((size_t)args_len + 1);
+        if (!args || (args_len > 0 && read_full(fd, args, args_len) != 1)) {
+            break;
+        }
+        args[args_len] = '\0';
+
+        int result = (flags & SERVER_INLINE)
+                         ? handle_inline(fd, &cache, scratch, args, payload_len)
+                         : handle_files(fd, scratch, args);
+        free(args);
+        args = NULL;
+        if (result < 0) {
+            break;
+        }
+    }
+    free(args);
+    cache_drop(&cache);
+}
+
+static void *server_main(void *unused) {
+    io_scratch_t scratch = {0};
+
+    (void)unused;
+    while (!stopping) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        serve_connection(fd, &scratch);
+        close(fd);
+    }
+    free_scratch(&scratch);
+    return NULL;
+}
+
+static int socket_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int serve_execute(const config_t *config) {
+    struct sockaddr_un addr;
+    struct sigaction action;
+    struct stat st;
+    pthread_t *threads = NULL;
+    int thread_count = config->threads;
+    int started = 0;
+
+    if (socket_address(config->serve_socket, &addr) < 0) {
+        return -1;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("creating socket");
+        return -1;
+    }
+    /* a socket left by a dead server is replaced, a live one is not */
+    if (lstat(config->serve_socket, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        if (connect(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            fprintf(stderr, "a server is already listening on %s\n", config->serve_socket);
+            close(listen_fd);
+            return -1;
+        }
+        unlink(config->serve_socket);
+        close(listen_fd);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            perror("creating socket");
+            return -1;
+        }
+    }
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0) {
+        perror("binding socket");
+        close(listen_fd);
+        return -1;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (thread_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cpus > 0) ? (int)cpus : 1;
+    }
+    threads = (pthread_t *)calloc((size_t)thread_count, sizeof(pthread_t));
+    if (threads) {
+        for (; started < thread_count - 1; started++) {
+            if (pthread_create(&threads[started], NULL, server_main, NULL) != 0) {
+                break;
+            }
+        }
+    }
+    printf("serving on %s with %d threads\n", config->serve_socket, started + 1);
+    fflush(stdout);
+
+    server_main(NULL);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    close(listen_fd);
+    unlink(config->serve_socket);
+    return 0;
+}
+
+/* append one word to the request args, quoted when it has blanks or quotes */
+static int append_word(char **args, size_t *len, const char *word) {
+    size_t word_len = strlen(word);
+    char quote = 0;
+
+    if (word_len == 0 || strpbrk(word, " \t\r\"'")) {
+        quote = strchr(word, '"') ? '\'' : '"';
+    }
+    char *grown = (char *)realloc(*args, *len + word_len + 4);
+    if (!grown) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    *args = grown;
+    if (*len > 0) {
+        grown[(*len)++] = ' ';
+    }
+    if (quote) {
+        grown[(*len)++] = quote;
+    }
+    memcpy(grown + *len, word, word_len);
+    *len += word_len;
+    if (quote) {
+        grown[(*len)++] = quote;
+    }
+    grown[*len] = '\0';
+    return 0;
+}
+
+/* the server has another working directory, relative file names are made absolute */
+static char *absolute_path(const char *path) {
+    char cwd[4096];
+
+    if (path[0] == '/') {
+        return strdup(path);
+    }
+    if (!getcwd(cwd, sizeof(cwd))) {
+        perror("reading current directory");
+        return NULL;
+    }
+    char *absolute = (char *)malloc(strlen(cwd) + strlen(path) + 2);
+    if (absolute) {
+        sprintf(absolute, "%s/%s", cwd, path);
+    }
+    return absolute;
+}
+
+static uint8_t *read_stdin(size_t *size) {
+    size_t capacity = 64 * 1024;
+    uint8_t *data = (uint8_t *)malloc(capacity);
+
+    *size = 0;
+    while (data) {
+        if (*size == capacity) {
+            capacity *= 2;
+            uint8_t *grown = (uint8_t *)realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                data = NULL;
+                break;
+            }
+            data = grown;
+        }
+        ssize_t n = read(STDIN_FILENO, data + *size, capacity - *size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            perror("reading standard input");
+            free(data);
+            return NULL;
+        }
+        if (n == 0) {
+            return data;
+        }
+        *size += (size_t)n;
+    }
+    fprintf(stderr, "memory allocation failed\n");
+    return NULL;
+}
+
+int client_main(int argc, char *argv[]) {
+    struct sockaddr_un addr;
+    uint8_t header[REQUEST_HEADER_SIZE];
+    char *args = NULL;
+    size_t args_len = 0;
+    uint8_t *payload = NULL;
+    size_t payload_len = 0;
+    uint8_t *body = NULL;
+    int inline_data = 1;
+    int stdout_given = 0;
+    int file_output = 0;
+    int fd = -1;
+    int result = -1;
+
+    if (argc < 1) {
+        fprintf(stderr, "usage: isenchef client <socket> [job options]\n");
+        return -1;
+    }
+    for (int i = 1; i < argc; i++) {
+        int is_input = strcmp(argv[i], "--in") == 0 || strcmp(argv[i], "-i") == 0;
+        int is_file = is_input || strcmp(argv[i], "--out") == 0 || strcmp(argv[i], "-o") == 0;
+        /* "-" is this process's stdin or stdout, which only the inline path carries */
+        if (is_file && i + 1 < argc && is_stdio_path(argv[i + 1])) {
+            stdout_given |= !is_input;
+            i++;
+            continue;
+        }
+        if (append_word(&args, &args_len, argv[i]) < 0) {
+            goto cleanup;
+        }
+        if (is_file && i + 1 < argc) {
+            file_output |= !is_input;
+            char *path = absolute_path(argv[++i]);
+            if (!path || append_word(&args, &args_len, path) < 0) {
+                free(path);
+                goto cleanup;
+            }
+            free(path);
+            if (is_input) {
+                inline_data = 0;
+            }
+        }
+    }
+    if (stdout_given && !inline_data) {
+        fprintf(stderr, "--out - needs the input on stdin, not --in <file>\n");
+        goto cleanup;
+    }
+    /* input on stdin travels inline and its result comes back on stdout */
+    if (file_output && inline_data) {
+        fprintf(stderr, "--out <file> needs --in <file>, or redirect stdout\n");
+        goto cleanup;
+    }
+    if (!args && append_word(&args, &args_len, "") < 0) {
+        goto cleanup;
+    }
+    if (args_len > SERVER_MAX_ARGS) {
+        fprintf(stderr, "job options too long\n");
+        goto cleanup;
+    }
+    if (inline_data && !(payload = read_stdin(&payload_len))) {
+        goto cleanup;
+    }
+
+    if (socket_address(argv[0], &addr) < 0) {
+        goto cleanup;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connecting to server");
+        goto cleanup;
+    }
+    put_u32(header, inline_data ? SERVER_INLINE : 0);
+    put_u32(header + 4, (uint32_t)args_len);
+    put_u64(header + 8, payload_len);
+    if (write_full(fd, header, sizeof(header)) < 0 || write_full(fd, args, args_len) < 0 ||
+        write_full(fd, payload, payload_len) < 0) {
+        perror("sending request");
+        goto cleanup;
+    }
+
+    uint8_t response[RESPONSE_HEADER_SIZE];
+    if (read_full(fd, response, sizeof(response)) != 1) {
+        fprintf(stderr, "server closed the connection\n");
+        goto cleanup;
+    }
+    uint32_t status = get_u32(response);
+    uint64_t body_len = get_u64(response + 4);
+    if (body_len > SERVER_MAX_PAYLOAD * 2 || !(body = (uint8_t *)malloc((size_t)body_len + 1)) ||
+        (body_len > 0 && read_full(fd, body, (size_t)body_len) != 1)) {
+        fprintf(stderr, "invalid response from server\n");
+        goto cleanup;
+    }
+    if (status != 0) {
+        fprintf(stderr, "server: %.*s\n", (int)body_len, (const char *)body);
+        goto cleanup;
+    }
+    if (inline_data) {
+        if (write_full(STDOUT_FILENO, body, (size_t)body_len) < 0) {
+            perror("writing standard output");
+            goto cleanup;
+        }
+    } else {
+        printf("%.*s\n", (int)body_len, (const char *)body);
+    }
+    result = 0;
+
+cleanup:
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(body);
+    free(payload);
+    free(args);
+    return result;
+}
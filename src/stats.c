@@ -0,0 +1,126 @@
+/**
+ * @file stats.c
+ * @brief per-stage timing and byte counters behind --stats
+ *
+ * counters are atomics so batch and server threads can add to them at
+ * once. cpu time is process-wide, so it includes the worker pool.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include "../include/stats.h"
+
+typedef struct {
+    atomic_uint_fast64_t wall_ns;
+    atomic_uint_fast64_t cpu_ns;
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+    atomic_uint_fast64_t calls;
+} stage_counters_t;
+
+static const char *const stage_names[STATS_STAGES] = {
+    "read", "decode", "action", "encode", "write"
+};
+
+static int enabled = 0;
+static stage_counters_t stages[STATS_STAGES];
+static atomic_uint_fast64_t allocations;
+static atomic_uint_fast64_t reuses;
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void stats_enable(int on) {
+    enabled = on;
+}
+
+stats_mark_t stats_begin(void) {
+    stats_mark_t mark = {0, 0};
+    if (enabled) {
+        mark.wall_ns = clock_ns(CLOCK_MONOTONIC);
+        mark.cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    }
+    return mark;
+}
+
+void stats_end(stats_stage_t stage, stats_mark_t mark, uint64_t bytes_in, uint64_t bytes_out) {
+    if (!enabled) {
+        return;
+    }
+    stage_counters_t *counters = &stages[stage];
+    atomic_fetch_add(&counters->wall_ns, clock_ns(CLOCK_MONOTONIC) - mark.wall_ns);
+    atomic_fetch_add(&counters->cpu_ns, clock_ns(CLOCK_PROCESS_CPUTIME_ID) - mark.cpu_ns);
+    atomic_fetch_add(&counters->bytes_in, bytes_in);
+    atomic_fetch_add(&counters->bytes_out, bytes_out);
+    atomic_fetch_add(&counters->calls, 1);
+}
+
+void stats_count_alloc(void) {
+    if (enabled) {
+        atomic_fetch_add(&allocations, 1);
+    }
+}
+
+void stats_count_reuse(void) {
+    if (enabled) {
+        atomic_fetch_add(&reuses, 1);
+    }
+}
+
+void stats_print(FILE *out, int style) {
+    struct rusage usage;
+    uint64_t total_wall = 0;
+    uint64_t total_cpu = 0;
+
+    getrusage(RUSAGE_SELF, &usage);
+    if (style == STATS_JSON) {
+        fprintf(out, "{\"stages\": {");
+    } else {
+        fprintf(out, "%-8s %10s %10s %14s %14s %10s\n", "stage", "wall ms", "cpu ms",
+                "bytes in", "bytes out", "MB/s");
+    }
+    for (int i = 0; i < STATS_STAGES; i++) {
+        uint64_t wall = atomic_load(&stages[i].wall_ns);
+        uint64_t cpu = atomic_load(&stages[i].cpu_ns);
+        uint64_t bytes_in = atomic_load(&stages[i].bytes_in);
+        uint64_t bytes_out = atomic_load(&stages[i].bytes_out);
+        double mbps = wall ? (double)bytes_in / ((double)wall / 1e9) / 1e6 : 0.0;
+
+        total_wall += wall;
+        total_cpu += cpu;
+        if (style == STATS_JSON) {
+            fprintf(out, "%s\"%s\": {\"calls\": %llu, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+                         "\"bytes_in\": %llu, \"bytes_out\": %llu, \"mb_per_s\": %.1f}",
+                    i ? ", " : "", stage_names[i],
+                    (unsigned long long)atomic_load(&stages[i].calls), (double)wall / 1e6,
+                    (double)cpu / 1e6, (unsigned long long)bytes_in,
+                    (unsigned long long)bytes_out, mbps);
+        } else if (atomic_load(&stages[i].calls) > 0) {
+            fprintf(out, "%-8s %10.3f %10.3f %14llu %14llu %10.1f\n", stage_names[i],
+                    (double)wall / 1e6, (double)cpu / 1e6, (unsigned long long)bytes_in,
+                    (unsigned long long)bytes_out, mbps);
+        }
+    }
+
+    /* ru_maxrss is in kilobytes on linux */
+    if (style == STATS_JSON) {
+        fprintf(out, "}, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"allocations\": %llu, "
+                     "\"reused\": %llu, \"page_faults\": %ld, \"peak_rss_kb\": %ld}\n",
+                (double)total_wall / 1e6, (double)total_cpu / 1e6,
+                (unsigned long long)atomic_load(&allocations),
+                (unsigned long long)atomic_load(&reuses), usage.ru_minflt, usage.ru_maxrss);
+    } else {
+        fprintf(out, "%-8s %10.3f %10.3f\n", "total", (double)total_wall / 1e6,
+                (double)total_cpu / 1e6);
+        fprintf(out, "allocations: %llu (%llu more reused from the pool)\n",
+                (unsigned long long)atomic_load(&allocations),
+                (unsigned long long)atomic_load(&reuses));
+        fprintf(out, "page faults: %ld\n", usage.ru_minflt);
+        fprintf(out, "peak rss: %ld KiB\n", usage.ru_maxrss);
+    }
+}
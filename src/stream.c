@@ -0,0 +1,269 @@
+/**
+ * @file stream.c
+ * @brief chunked read -> decode -> action -> encode -> write pipeline
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/stream.h"
+#include "../include/pipeline.h"
+#include "../include/encoders.h"
+#include "../include/stats.h"
+#include "../include/async_io.h"
+#include "../include/buffer_pool.h"
+
+/* codec state of the input and output formats, carried from chunk to chunk */
+typedef struct {
+    format_t input_format;
+    format_t output_format;
+    hex_decoder_t hex_in;
+    base64_decoder_t base64_in;
+    hex_encoder_t hex_out;
+    base64_encoder_t base64_out;
+} stream_codecs_t;
+
+static void codecs_init(stream_codecs_t *codecs, format_t input_format, format_t output_format) {
+    codecs->input_format = input_format;
+    codecs->output_format = output_format;
+    hex_decoder_init(&codecs->hex_in);
+    base64_decoder_init(&codecs->base64_in);
+    hex_encoder_init(&codecs->hex_out);
+    base64_encoder_init(&codecs->base64_out);
+}
+
+/*
+ * decode a chunk of text, the whole of it: every character yields at most
+ * one byte, so an output as large as the chunk (plus the padded last hex
+ * digit) never fills up. on the last chunk the decoder is flushed.
+ */
+static int decode_chunk(stream_codecs_t *codecs, const char *text, size_t len, int last,
+                        uint8_t *output, size_t output_size, size_t *decoded) {
+    size_t consumed;
+    size_t produced;
+    size_t tail = 0;
+    int result;
+
+    STATS_BEGIN(decode_mark);
+    if (codecs->input_format == FORMAT_HEX) {
+        result = hex_decoder_update(&codecs->hex_in, text, len, output, output_size, &consumed,
+                                    &produced);
+        if (result == 0 && last) {
+            result = hex_decoder_final(&codecs->hex_in, output + produced,
+                                       output_size - produced, &tail);
+        }
+    } else {
+        result = base64_decoder_update(&codecs->base64_in, text, len, output, output_size,
+                                       &consumed, &produced);
+        if (result == 0 && last) {
+            result = base64_decoder_final(&codecs->base64_in, output + produced,
+                                          output_size - produced, &tail);
+        }
+    }
+    if (result < 0) {
+        fprintf(stderr, "invalid %s format\n",
+                (codecs->input_format == FORMAT_HEX) ? "hex" : "base64");
+        return -1;
+    }
+    *decoded = produced + tail;
+    STATS_END(STATS_DECODE, decode_mark, len, *decoded);
+    return 0;
+}
+
+/*
+ * encode a chunk (and on the last one what the encoder held back), then
+ * write it or hand it to the writer. with a writer, encoded is its buffer
+ * and raw output is already in it.
+ */
+static int write_chunk(FILE *file, async_writer_t *writer, stream_codecs_t *codecs,
+                       const uint8_t *data, size_t size, int last, char *encoded,
+                       size_t encoded_size, checksum_set_t *sums) {
+    const void *output = data;
+    size_t output_size = size;
+    size_t consumed;
+    size_t tail = 0;
+
+    STATS_BEGIN(encode_mark);
+    if (codecs->output_format == FORMAT_HEX) {
+        hex_encoder_update(&codecs->hex_out, data, size, encoded, encoded_size, &consumed,
+                           &output_size);
+        output = encoded;
+    } else if (codecs->output_format == FORMAT_BASE64) {
+        base64_encoder_update(&codecs->base64_out, data, size, encoded, encoded_size, &consumed,
+                              &output_size);
+        if (last && base64_encoder_final(&codecs->base64_out, encoded + output_size,
+                                         encoded_size - output_size, &tail) < 0) {
+            fprintf(stderr, "base64 encoding failed\n");
+            return -1;
+        }
+        output = encoded;
+        output_size += tail;
+    }
+    if (codecs->output_format != FORMAT_BYTES) {
+        STATS_END(STATS_ENCODE, encode_mark, size, output_size);
+        /* raw output was summed with the transformed data */
+        checksum_set_update(sums, CHECKSUM_OUTPUT, output, output_size);
+    }
+    STATS_BEGIN(write_mark);
+    if (writer) {
+        if (async_writer_submit(writer, output_size) < 0) {
+            return -1;
+        }
+    } else if (fwrite(output, 1, output_size, file) != output_size) {
+        fprintf(stderr, "failed to write entire file\n");
+        return -1;
+    }
+    STATS_END(STATS_WRITE, write_mark, output_size, output_size);
+    return 0;
+}
+
+int stream_execute(const config_t *config, checksum_set_t *sums) {
+    const size_t chunk = config->chunk_size;
+    /* room for the padded last hex digit */
+    const size_t data_size = chunk + 1;
+    /* a chunk plus the two bytes the base64 encoder held back, plus the final quad */
+    const size_t encoded_size = (config->output_format == FORMAT_HEX)
+                                    ? data_size * 2
+                                    : ((data_size + 2) / 3 + 1) * 4;
+    const int raw_in = config->input_format == FORMAT_BYTES;
+    const int raw_out = config->output_format == FORMAT_BYTES;
+    stream_codecs_t codecs;
+    pipeline_t pipeline;
+    async_reader_t *reader = NULL;
+    async_writer_t *writer = NULL;
+    FILE *in = NULL;
+    FILE *out = NULL;
+    char *text = NULL;
+    uint8_t *data = NULL;
+    char *encoded = NULL;
+    size_t text_capacity = 0;
+    size_t data_capacity = 0;
+    size_t encoded_capacity = 0;
+    int eof = 0;
+    int result = -1;
+
+    if (pipeline_init(&pipeline, config->steps, config->step_count) < 0) {
+        return -1;
+    }
+    codecs_init(&codecs, config->input_format, config->output_format);
+
+    in = open_input(config->input_file);
+    if (!in) {
+        perror("opening input file");
+        goto cleanup;
+    }
+    /* chunks are written while the input is read, truncating it would lose them */
+    if (output_is_input(in, config->output_file)) {
+        fprintf(stderr, "--stream cannot write over its input, drop --stream or use --in-place\n");
+        goto cleanup;
+    }
+    out = open_output(config->output_file);
+    if (!out) {
+        perror("opening output file");
+        goto cleanup;
+    }
+    /* whatever stdio already holds goes out before the writer takes the descriptor */
+    fflush(out);
+    reader = async_reader_open(fileno(in), chunk, config->io_backend);
+    writer = async_writer_open(fileno(out), raw_out ? data_size : encoded_size,
+                               config->io_backend);
+
+    /* the rings hold the read chunks and the output, only the rest is allocated here */
+    if ((!raw_in || !reader) && !(data = (uint8_t *)pool_alloc(data_size, &data_capacity))) {
+        goto cleanup;
+    }
+    if (!raw_in && !reader && !(text = (char *)pool_alloc(chunk, &text_capacity))) {
+        goto cleanup;
+    }
+    if (!raw_out && !writer &&
+        !(encoded = (char *)pool_alloc(encoded_size, &encoded_capacity))) {
+        goto cleanup;
+    }
+
+    while (!eof) {
+        uint8_t *input;
+        uint8_t *output = NULL;
+        uint8_t *work;
+        size_t got;
+        size_t decoded;
+
+        STATS_BEGIN(read_mark);
+        if (reader) {
+            if (async_reader_next(reader, &input, &got) < 0) {
+                goto cleanup;
+            }
+        } else {
+            input = raw_in ? data : (uint8_t *)text;
+            got = fread(input, 1, chunk, in);
+            if (ferror(in)) {
+                perror("reading input file");
+                goto cleanup;
+            }
+        }
+        STATS_END(STATS_READ, read_mark, got, got);
+        eof = got < chunk;
+
+        if (writer && !(output = async_writer_buffer(writer))) {
+            goto cleanup;
+        }
+        if (raw_in) {
+            work = input;
+            decoded = got;
+        } else {
+            /* the whole-file decoders stop at the first nul */
+            char *nul = memchr(input, '\0', got);
+            if (nul) {
+                got = (size_t)(nul - (char *)input);
+                eof = 1;
+            }
+            /* once base64 padding shows up the rest of the input is ignored */
+            if (config->input_format == FORMAT_BASE64 && memchr(input, '=', got)) {
+                eof = 1;
+            }
+            work = (raw_out && output) ? output : data;
+            if (decode_chunk(&codecs, (const char *)input, got, eof, work, data_size,
+                             &decoded) < 0) {
+                goto cleanup;
+            }
+        }
+
+        /* raw output to a writer lands in its buffer on the way through the steps */
+        STATS_BEGIN(action_mark);
+        int applied;
+        if (raw_out && output && work != output) {
+            applied = pipeline_run_summed(&pipeline, work, output, decoded, sums);
+            work = output;
+        } else {
+            applied = pipeline_run_summed(&pipeline, work, work, decoded, sums);
+        }
+        if (applied < 0) {
+            fprintf(stderr, "failed to apply action\n");
+            goto cleanup;
+        }
+        STATS_END(STATS_ACTION, action_mark, decoded, decoded);
+
+        if (write_chunk(out, writer, &codecs, work, decoded, eof,
+                        output ? (char *)output : encoded, encoded_size, sums) < 0) {
+            goto cleanup;
+        }
+    }
+    result = 0;
+
+cleanup:
+    async_reader_close(reader);
+    if (async_writer_close(writer) < 0) {
+        result = -1;
+    }
+    if (out && close_file(out) != 0 && result == 0) {
+        perror("closing output file");
+        result = -1;
+    }
+    if (in) {
+        close_file(in);
+    }
+    pool_free(encoded, encoded_capacity);
+    pool_free(data, data_capacity);
+    pool_free(text, text_capacity);
+    pipeline_free(&pipeline);
+    return result;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file workers.c
+ * @brief process-wide worker pool for data-parallel loops
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "../include/workers.h"
+
+/* one loop shared by every thread, tasks are claimed with an atomic counter */
+typedef struct {
+    workers_fn fn;
+    void *arg;
+    size_t tasks;
+    atomic_size_t next;
+    atomic_size_t done;
+} workers_job_t;
+
+static pthread_t *threads = NULL;
+static int thread_count = 0;  /* pool threads, the caller is not counted */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t finished = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;  /* one loop at a time */
+static workers_job_t *job = NULL;
+static unsigned long generation = 0;
+static int active = 0;  /* pool threads currently holding a pointer to job */
+static int stopping = 0;
+static _Thread_local int inside_task = 0;
+
+static void take_tasks(workers_job_t *current) {
+    size_t index;
+
+    inside_task = 1;
+    while ((index = atomic_fetch_add(&current->next, 1)) < current->tasks) {
+        current->fn(current->arg, index);
+        if (atomic_fetch_add(&current->done, 1) + 1 == current->tasks) {
+            pthread_mutex_lock(&lock);
+            pthread_cond_broadcast(&finished);
+            pthread_mutex_unlock(&lock);
+        }
+    }
+    inside_task = 0;
+}
+
+static void *worker_main(void *unused) {
+    unsigned long seen = 0;
+
+    (void)unused;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!stopping && (generation == seen || !job)) {
+            pthread_cond_wait(&wake, &lock);
+        }
+        if (stopping) {
+            break;
+        }
+        seen = generation;
+        workers_job_t *current = job;
+        active++;
+        pthread_mutex_unlock(&lock);
+        take_tasks(current);
+        pthread_mutex_lock(&lock);
+        if (--active == 0) {
+            pthread_cond_broadcast(&finished);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int workers_start(int count) {
+    if (count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = (cpus > 0) ? (int)cpus : 1;
+    }
+    if (threads || count == 1) {
+        return 0;
+    }
+
+    threads = (pthread_t *)calloc((size_t)count - 1, sizeof(pthread_t));
+    if (!threads) {
+        fprintf(stderr, "memory allocation failed\n");
+        return -1;
+    }
+    stopping = 0;
+    for (int i = 0; i < count - 1; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, NULL) != 0) {
+            fprintf(stderr, "failed to start worker thread\n");
+            thread_count = i;
+            workers_stop();
+            return -1;
+        }
+    }
+    thread_count = count - 1;
+    return 0;
+}
+
+void workers_stop(void) {
+    if (!threads) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    threads = NULL;
+    thread_count = 0;
+}
+
+int workers_count(void) {
+    return thread_count + 1;
+}
+
+void workers_run(size_t tasks, workers_fn fn, void *arg) {
+    workers_job_t current;
+
+    if (tasks == 0) {
+        return;
+    }
+    if (thread_count == 0 || inside_task || tasks == 1) {
+        for (size_t i = 0; i < tasks; i++) {
+            fn(arg, i);
+        }
+        return;
+    }
+
+    current.fn = fn;
+    current.arg = arg;
+    current.tasks = tasks;
+    atomic_init(&current.next, 0);
+    atomic_init(&current.done, 0);
+
+    pthread_mutex_lock(&run_lock);
+    pthread_mutex_lock(&lock);
+    job = &current;
+    generation++;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    take_tasks(&current);
+
+    /* the job lives on this stack, wait until no thread can still touch it */
+    pthread_mutex_lock(&lock);
+    while (atomic_load(&current.done) < tasks || active > 0) {
+        pthread_cond_wait(&finished, &lock);
+    }
+    job = NULL;
+    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&run_lock);
+}
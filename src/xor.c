@@ -0,0 +1,127 @@
+/**
+ * @file xor.c
+ * @brief repeating-key xor applied a vector at a time
+ *
+ * the key is laid out repeatedly in a pattern buffer, so the key bytes for
+ * any position are one unaligned load away and the phase only moves by a
+ * precomputed step, no division per byte.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../include/isenchef.h"
+#include "../include/xor.h"
+#include "../include/encoders.h"
+#include "../include/simd.h"
+
+int xor_key_init(xor_key_t *key, const uint8_t *bytes, size_t length) {
+    key->pattern = NULL;
+    key->length = 0;
+    if (!bytes || length == 0) {
+        return -1;
+    }
+
+    key->pattern = (uint8_t *)malloc(length + XOR_MAX_WIDTH);
+    if (!key->pattern) {
+        report_error("memory allocation failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < length + XOR_MAX_WIDTH; i++) {
+        key->pattern[i] = bytes[i % length];
+    }
+    key->length = length;
+    return 0;
+}
+
+int xor_key_from_text(xor_key_t *key, const char *text) {
+    if (!text) {
+        key->pattern = NULL;
+        key->length = 0;
+        return -1;
+    }
+    return xor_key_init(key, (const uint8_t *)text, strlen(text));
+}
+
+int xor_key_from_hex(xor_key_t *key, const char *hex) {
+    size_t digits = 0;
+    uint8_t *bytes;
+
+    key->pattern = NULL;
+    key->length = 0;
+    if (!hex) {
+        return -1;
+    }
+    for (const char *c = hex; *c; c++) {
+        if (!isspace((unsigned char)*c)) {
+            digits++;
+        }
+    }
+    /* an odd digit count is almost certainly a typo, not a padded nibble */
+    if (digits == 0 || digits % 2 != 0) {
+        return -1;
+    }
+
+    bytes = (uint8_t *)malloc(digits / 2);
+    if (!bytes) {
+        report_error("memory allocation failed\n");
+        return -1;
+    }
+    int length = decode_hex(hex, bytes, digits / 2);
+    int result = (length > 0) ? xor_key_init(key, bytes, (size_t)length) : -1;
+    free(bytes);
+    return result;
+}
+
+void xor_apply(const xor_key_t *key, const uint8_t *src, uint8_t *dst, size_t size,
+               uint64_t offset) {
+    const size_t length = key->length;
+    const size_t step = 8 % length;
+    size_t phase = (size_t)(offset % length);
+    size_t done = 0;
+    size_t i;
+
+    switch (cpu_level()) {
+#ifdef ISENCHEF_X86
+        case CPU_AVX2:
+            done = xor_apply_avx2(key->pattern, length, phase, src, dst, size);
+            break;
+        case CPU_SSSE3:
+        case CPU_SSE2:
+            done = xor_apply_sse2(key->pattern, length, phase, src, dst, size);
+            break;
+#endif
+        default:
+            break;
+    }
+    if (done == size) {
+        return;
+    }
+    phase = (phase + done % length) % length;
+
+    /* scalar path a machine word at a time, then the last few bytes */
+    for (i = done; i + 8 <= size; i += 8) {
+        uint64_t word;
+        uint64_t mask;
+        memcpy(&word, src + i, 8);
+        memcpy(&mask, key->pattern + phase, 8);
+        word ^= mask;
+        memcpy(dst + i, &word, 8);
+        phase += step;
+        if (phase >= length) {
+            phase -= length;
+        }
+    }
+    for (; i < size; i++) {
+        dst[i] = src[i] ^ key->pattern[phase];
+        if (++phase == length) {
+            phase = 0;
+        }
+    }
+}
+
+void xor_key_free(xor_key_t *key) {
+    free(key->pattern);
+    key->pattern = NULL;
+    key->length = 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file xor_simd.c
+ * @brief sse2/avx2 kernels for repeating-key xor
+ *
+ * each vector of key bytes is an unaligned load from the repeated pattern.
+ * when the key length divides the vector width the key vector never
+ * changes and the loop is a plain load/xor/store stream.
+ */
+
+#include "../include/simd.h"
+
+#ifdef ISENCHEF_X86
+
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+SSE2 size_t xor_apply_sse2(const uint8_t *pattern, size_t length, size_t phase,
+                           const uint8_t *src, uint8_t *dst, size_t size) {
+    const size_t step = 16 % length;
+    size_t i = 0;
+
+    if (step == 0) {
+        const __m128i k = _mm_loadu_si128((const __m128i *)(pattern + phase));
+        for (; i + 64 <= size; i += 64) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+            __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(a, k));
+            _mm_storeu_si128((__m128i *)(dst + i + 16), _mm_xor_si128(b, k));
+            _mm_storeu_si128((__m128i *)(dst + i + 32), _mm_xor_si128(c, k));
+            _mm_storeu_si128((__m128i *)(dst + i + 48), _mm_xor_si128(d, k));
+        }
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v, k));
+        }
+        return i;
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i k = _mm_loadu_si128((const __m128i *)(pattern + phase));
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v, k));
+        phase += step;
+        if (phase >= length) {
+            phase -= length;
+        }
+    }
+    return i;
+}
+
+AVX2 size_t xor_apply_avx2(const uint8_t *pattern, size_t length, size_t phase,
+                           const uint8_t *src, uint8_t *dst, size_t size) {
+    const size_t step = 32 % length;
+    size_t i = 0;
+
+    if (step == 0) {
+        const __m256i k = _mm256_loadu_si256((const __m256i *)(pattern + phase));
+        for (; i + 128 <= size; i += 128) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+            __m256i c = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+            __m256i d = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a, k));
+            _mm256_storeu_si256((__m256i *)(dst + i + 32), _mm256_xor_si256(b, k));
+            _mm256_storeu_si256((__m256i *)(dst + i + 64), _mm256_xor_si256(c, k));
+            _mm256_storeu_si256((__m256i *)(dst + i + 96), _mm256_xor_si256(d, k));
+        }
+        for (; i + 32 <= size; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(v, k));
+        }
+        return i;
+    }
+    for (; i + 32 <= size; i += 32) {
+        __m256i k = _mm256_loadu_si256((const __m256i *)(pattern + phase));
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(v, k));
+        phase += step;
+        if (phase >= length) {
+            phase -= length;
+        }
+    }
+    return i;
+}
+
+#endif /* ISENCHEF_X86 */